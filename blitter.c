@@ -0,0 +1,199 @@
+/**
+ * @file    blitter.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Functions for putting sprites and filled rectangles in a 4 * 128 byte
+ * screen buffer. The buffer is one row of 128 columns for each page and
+ * the sprites are laid out the same way, one row of columns per page.
+ * Everything is done a word (4 columns) at a time where the buffer
+ * allows it, so the buffers must be word aligned.
+ *
+ * The words are read and written with memcpy instead of through a
+ * uint32_t pointer, which isn't allowed on the uint8_t sprite arrays.
+ * GCC turns them into plain loads and stores (lwl/lwr for an unaligned
+ * sprite). It's __builtin_memcpy as there's no C library on the board.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "declaration.h"    /* Declarations of project specific functions */
+
+/**
+ * Reads 4 columns as a word, the address doesn't have to be aligned.
+ *
+ * @param [in] src The first column
+ */
+static inline uint32_t load_word(const uint8_t *src) {
+    uint32_t word;
+    __builtin_memcpy(&word, src, 4);
+    return word;
+}
+
+/**
+ * Writes a word to 4 columns on a word boundary.
+ *
+ * @param [out] dst The first column, word aligned
+ * @param [in] word What is put there
+ */
+static inline void store_word(uint8_t *dst, uint32_t word) {
+    __builtin_memcpy(__builtin_assume_aligned(dst, 4), &word, 4);
+}
+
+/**
+ * Combines a word in the buffer with a word from the sprite.
+ *
+ * @param [in] dst What is in the buffer
+ * @param [in] src What is put there
+ * @param [in] op How they are combined
+ */
+static inline uint32_t blit_apply(uint32_t dst, uint32_t src, Blit_Op op) {
+    switch(op) {
+        case BLIT_OR:
+            return dst | src;
+        case BLIT_AND:
+            return dst & src;
+        case BLIT_XOR:
+            return dst ^ src;
+        default:
+            return src;
+    }
+}
+
+/**
+ * Puts count columns on one page. The columns up to the first word
+ * boundary and after the last one are done a byte at a time and the
+ * rest a word at a time.
+ *
+ * @param [out] dst The first column in the buffer
+ * @param [in] src The first column of the sprite, NULL to fill with value
+ * @param [in] value The fill value when there's no sprite
+ * @param [in] count How many columns
+ * @param [in] op How they are combined with the buffer
+ */
+static void blit_span(uint8_t *dst, const uint8_t *src, uint8_t value, int count, Blit_Op op) {
+    uint32_t word = value * 0x01010101u;
+
+    while(count > 0 && ((uintptr_t) dst & 3)) {
+        *dst = blit_apply(*dst, src ? *src++ : value, op);
+        dst++;
+        count--;
+    }
+
+    for(; count >= 4; count -= 4, dst += 4) {
+        // The sprite may not be aligned, load_word() takes care of that
+        if (src) {
+            word = load_word(src);
+            src += 4;
+        }
+        // dst is on a word boundary here, which lets GCC use a plain load
+        store_word(dst, blit_apply(load_word(__builtin_assume_aligned(dst, 4)),
+                word, op));
+    }
+
+    while(count > 0) {
+        *dst = blit_apply(*dst, src ? *src++ : value, op);
+        dst++;
+        count--;
+    }
+}
+
+/**
+ * Puts a sprite or a fill value in a rectangle of the buffer. The parts
+ * outside of the screen are left out.
+ *
+ * @param [out] target The screen buffer
+ * @param [in] src The top left column of the sprite data, NULL to fill with value
+ * @param [in] stride How far apart the pages of the sprite data are
+ * @param [in] value The fill value when there's no sprite
+ * @param [in] x The column of the left side of the rectangle
+ * @param [in] page The page of the top of the rectangle
+ * @param [in] width How many columns wide it is
+ * @param [in] pages How many pages high it is
+ * @param [in] op How it is combined with the buffer
+ */
+static void blit_rect(uint8_t *target, const uint8_t *src, int stride, uint8_t value,
+        int x, int page, int width, int pages, Blit_Op op) {
+    int skip = 0, top = page, last = page + pages;
+
+    // Clip the sides
+    if (x < 0) {
+        skip = -x;
+        width += x;
+        x = 0;
+    }
+    if (x + width > 128)
+        width = 128 - x;
+    if (width <= 0)
+        return;
+
+    // Clip the top and bottom
+    if (last > 4)
+        last = 4;
+
+    for(; page < last; page++) {
+        if (page < 0)
+            continue;
+        blit_span(&target[page*128 + x],
+                src ? &src[(page - top)*stride + skip] : 0,
+                value, width, op);
+    }
+}
+
+/**
+ * Puts a sprite in the buffer.
+ *
+ * @param [out] target The screen buffer
+ * @param [in] sprite The sprite to put there
+ * @param [in] x The column of the left side of the sprite
+ * @param [in] page The page of the top of the sprite
+ * @param [in] op How it is combined with the buffer
+ */
+void blit(uint8_t *target, const Sprite *sprite, int x, int page, Blit_Op op) {
+    blit_rect(target, sprite->data, sprite->width, 0, x, page, sprite->width, sprite->pages, op);
+}
+
+/**
+ * Puts a rectangle of a whole screen image at the same place in the
+ * buffer.
+ *
+ * @param [out] target The screen buffer
+ * @param [in] image The 4 * 128 byte image
+ * @param [in] x The column of the left side of the rectangle
+ * @param [in] page The page of the top of the rectangle
+ * @param [in] width How many columns wide it is
+ * @param [in] pages How many pages high it is
+ * @param [in] op How it is combined with the buffer
+ */
+void blit_region(uint8_t *target, const uint8_t *image, int x, int page, int width, int pages, Blit_Op op) {
+    if (x < 0 || page < 0)
+        return;
+    blit_rect(target, &image[page*128 + x], 128, 0, x, page, width, pages, op);
+}
+
+/**
+ * Puts the same value in every column of a rectangle.
+ *
+ * @param [out] target The screen buffer
+ * @param [in] x The column of the left side of the rectangle
+ * @param [in] page The page of the top of the rectangle
+ * @param [in] width How many columns wide it is
+ * @param [in] pages How many pages high it is
+ * @param [in] value The value of each column
+ * @param [in] op How it is combined with the buffer
+ */
+void blit_fill(uint8_t *target, int x, int page, int width, int pages, uint8_t value, Blit_Op op) {
+    blit_rect(target, 0, 0, value, x, page, width, pages, op);
+}
+
+/**
+ * Clears the whole buffer, a word at a time.
+ *
+ * @param [out] target The screen buffer
+ */
+void blit_clear(uint8_t *target) {
+    unsigned char i;
+    for(i = 0; i < 128; i++)
+        store_word(&target[i*4], 0);
+}
@@ -13,12 +13,11 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"    /* Declarations of project specific functions */
 
 char textbuffer[4][16];
 
-const uint8_t const game_over_font[] = {
+const uint8_t game_over_font[] = {
   //First page, 16 byte per row
   //0...                                         15
     255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , 255 , //15
@@ -63,7 +62,7 @@ const uint8_t const game_over_font[] = {
 
 };
 
-const uint8_t const numFont[] = {
+const uint8_t numFont[] = {
     7   , 5  , 5   , 5  , 7   , // 0 spot 0
     112 , 80 , 80  , 80 , 112 , // 0 spot 0
     2   , 6  , 2   , 2  , 7   , // 1 spot 0
@@ -86,15 +85,50 @@ const uint8_t const numFont[] = {
     112 , 80 , 112 , 16 , 16  , // 9 spot 1
 };
 
-const uint8_t const highscoreFont[] = {
+const uint8_t highscoreFont[] = {
     220 , 17 , 156 , 5  , 220 , 0 , 255 , 0 ,   // Page 1
     221 , 85 , 93  , 89 , 213 , 0 , 255 , 0 ,   // Page 2
     221 , 17 , 209 , 81 , 221 , 0 , 255 , 0 ,   // Page 3
     85  , 81 , 117 , 84 , 85  , 0 , 127 , 0 ,   // Page 4
 };
 
+// The gravity of each level, one cell a second at level 0 and then faster
+// the same way as the modern guideline, (0.8 - level * 0.007) ^ level
+// seconds per cell, until it drops all the way at once.
+const uint32_t gravityTable[GRAVITY_LEVELS] = {
+    GRAVITY_MS(1000), GRAVITY_MS(793), GRAVITY_MS(618), GRAVITY_MS(473),
+    GRAVITY_MS(355), GRAVITY_MS(262), GRAVITY_MS(190), GRAVITY_MS(135),
+    GRAVITY_MS(94), GRAVITY_MS(64), GRAVITY_MS(43), GRAVITY_MS(28),
+    GRAVITY_MS(18.2), GRAVITY_MS(11.4), GRAVITY_MS(7.1), GRAVITY_MS(4.3),
+    GRAVITY_MS(2.5), GRAVITY_MS(1.5), GRAVITY_G(20)
+};
+
+// A row of squares across the play-field as one 32 pixel high column,
+// page 0 in the low byte. Looked up 5 squares at a time, the mask of
+// square 0-4 in the first half and the mask of square 5-9 in the second.
+const uint32_t rowFont[2*32] = {
+    // Squares 0-4
+    0x00000000, 0x70000000, 0x0E000000, 0x7E000000,
+    0x01C00000, 0x71C00000, 0x0FC00000, 0x7FC00000,
+    0x00380000, 0x70380000, 0x0E380000, 0x7E380000,
+    0x01F80000, 0x71F80000, 0x0FF80000, 0x7FF80000,
+    0x00070000, 0x70070000, 0x0E070000, 0x7E070000,
+    0x01C70000, 0x71C70000, 0x0FC70000, 0x7FC70000,
+    0x003F0000, 0x703F0000, 0x0E3F0000, 0x7E3F0000,
+    0x01FF0000, 0x71FF0000, 0x0FFF0000, 0x7FFF0000,
+    // Squares 5-9
+    0x00000000, 0x0000E000, 0x00001C00, 0x0000FC00,
+    0x00000380, 0x0000E380, 0x00001F80, 0x0000FF80,
+    0x00000070, 0x0000E070, 0x00001C70, 0x0000FC70,
+    0x000003F0, 0x0000E3F0, 0x00001FF0, 0x0000FFF0,
+    0x0000000E, 0x0000E00E, 0x00001C0E, 0x0000FC0E,
+    0x0000038E, 0x0000E38E, 0x00001F8E, 0x0000FF8E,
+    0x0000007E, 0x0000E07E, 0x00001C7E, 0x0000FC7E,
+    0x000003FE, 0x0000E3FE, 0x00001FFE, 0x0000FFFE,
+};
+
 //Font for menu
-const uint8_t const menuFont[512] = {
+const uint8_t menuFont[512] = {
     //First page, 16 byte per row
   //0...                                         15
     255 , 255 , 255 , 255 , 255 , 255 , 1   , 129 , 153 , 13 , 1   , 225 , 1   , 1   , 1   , 225 , //15
@@ -138,7 +172,7 @@ const uint8_t const menuFont[512] = {
 };
 
 //Font for the game
-const uint8_t const gameFont[512] = {
+const uint8_t gameFont[512] = {
   //First page, 16 byte per row
   //0...                                         15
     0 , 0 , 252 , 4 , 4 , 4 , 4 , 4 , 4 , 4 , 4 , 252 , 0 , 0 , 0 , 0 , //15
@@ -181,7 +215,7 @@ const uint8_t const gameFont[512] = {
     0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0 , 0 , 0 , 0 , 0  , 0  , //127
 };
 
-const uint8_t const font[] = {
+const uint8_t font[] = {
     0 , 0   , 0   , 0   , 0   , 0   , 0  , 0 ,
     0 , 0   , 0   , 0   , 0   , 0   , 0  , 0 ,
     0 , 0   , 0   , 0   , 0   , 0   , 0  , 0 ,
@@ -312,7 +346,7 @@ const uint8_t const font[] = {
     0 , 120 , 68  , 66  , 68  , 120 , 0  , 0 ,
 };
 
-const uint8_t const icon[] = {
+const uint8_t icon[] = {
     255 , 255 , 255 , 255 , 255 , 255 , 127 , 187 ,
     68  , 95  , 170 , 93  , 163 , 215 , 175 , 95  ,
     175 , 95  , 175 , 95  , 223 , 111 , 175 , 247 ,
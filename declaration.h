@@ -16,7 +16,6 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include <stdbool.h>        /* To be able to use boolean */
 
 // Declare different types of pieces
@@ -41,8 +40,148 @@ typedef struct {
 typedef struct {
     Square piece[4];   // There's always 4 pieces
     Piece_Type piece_type;
+    unsigned char rotation; // Which of the 4 orientations the shape is in
 } Shape;
 
+// The rows a shape covered when it was locked into the grid
+typedef struct {
+    unsigned char bottom;
+    unsigned char top;
+} Row_Range;
+
+// A piece covers at most 4 rows so this is the most rows
+// that can be removed at the same time
+#define MAX_CLEARED_ROWS 4
+
+// Random
+typedef struct {
+    uint64_t state;
+    uint64_t inc;
+} pcg32_random_t;
+
+// Everything about one game. It's only changed by game_start() and
+// game_step() so any number of games can be played side by side.
+typedef struct {
+    uint16_t grid[32+1];            // The bitboard, see tetrishelper.c
+    unsigned char skyline[10];      // The height of every column
+    pcg32_random_t rng;             // Where the pieces come from
+    Shape shape;                    // The falling shape
+    Shape next;                     // The next shape, shown at the top
+    uint32_t score;                 // In BCD, one digit per nibble
+    unsigned int level;
+    unsigned int rows;              // Rows removed in total
+    unsigned int pieces;            // Shapes locked in total
+    unsigned char cleared[MAX_CLEARED_ROWS];    // The rows removed by the last line clear
+    uint32_t time;                  // The scheduler tick the game is at
+
+    // Auto repeat
+    unsigned char repeating;        // The buttons held since they were pressed
+    uint32_t repeat_at[3];          // When each of them repeats next
+    uint32_t soft_drop_at;          // When soft drop was last pressed
+
+    // Gravity and lock delay
+    uint32_t fallen;                // Part of a cell fallen, 16.16 fixed point
+    bool grounded;                  // The shape is resting on something
+    uint32_t lock_at;               // When it's locked if it's still resting
+    unsigned char lock_resets;
+    unsigned char lowest_row;       // The lowest the shape has been
+    bool over;
+} Game_State;
+
+// What the player did up to a game step
+typedef struct {
+    uint32_t time;                  // The scheduler tick to step to
+    unsigned char held;             // The buttons held down
+    unsigned char pressed;          // The buttons pressed since the last step
+    uint32_t pressed_at[4];         // When each of them was pressed, BTN1 first
+} Game_Input;
+
+// The backgrounds a frame can start from
+typedef enum {
+    LAYER_BLANK,
+    LAYER_GAME,
+    LAYER_MENU,
+    LAYER_HISCORE
+} Layer;
+
+// How a blit is combined with what is already in the buffer
+typedef enum {
+    BLIT_COPY,
+    BLIT_OR,
+    BLIT_AND,
+    BLIT_XOR
+} Blit_Op;
+
+// An image that is pages high and width columns wide,
+// stored one row of columns per page
+typedef struct {
+    const uint8_t *data;
+    unsigned char width;
+    unsigned char pages;
+} Sprite;
+
+// A score drawn into a 5 column wide strip across all 4 pages,
+// one digit on each half page. Only the digits that changed since
+// the last time are drawn again.
+typedef struct {
+    uint32_t score;     // The BCD score in the strip
+    bool valid;         // False until the first digits are drawn
+    uint8_t strip[5*4];
+} Score_Cache;
+
+// A function run by the scheduler
+typedef void (*Task)(void);
+// Scheduler ticks (timer 2 interrupts) per second
+#define SCHEDULER_HZ 1000
+// How often the buttons are sampled, the game logic is run and the
+// screen is drawn (if anything changed), in scheduler ticks
+#define INPUT_PERIOD 1
+#define LOGIC_PERIOD 16
+#define RENDER_PERIOD 16
+// Scheduler ticks between each step of an animation
+#define ANIMATION_PERIOD 8
+// Logic frames per second, the game speeds are counted in logic frames
+#define LOGIC_HZ (SCHEDULER_HZ / LOGIC_PERIOD)
+// Milliseconds to scheduler ticks
+#define MS_TO_TICKS(ms) ((ms) * SCHEDULER_HZ / 1000)
+
+// Gravity is in cells per logic frame as 16.16 fixed point
+#define GRAVITY_ONE 0x10000
+// The gravity of falling one cell every ms milliseconds
+#define GRAVITY_MS(ms) ((uint32_t) (GRAVITY_ONE * (1000.0 * LOGIC_PERIOD / SCHEDULER_HZ) / (ms)))
+// The gravity of falling g cells every logic frame
+#define GRAVITY_G(g) ((uint32_t) (g) * GRAVITY_ONE)
+// Levels in the gravity table, the last one is used for every level after it
+#define GRAVITY_LEVELS 19
+
+// A button being pressed or released
+typedef struct {
+    uint32_t time;          // The scheduler tick it happened on
+    unsigned char button;   // The button's bit, same as in hal_buttons()
+    bool pressed;           // false if it was released
+} Input_Event;
+
+// Runs of buttons a game recording has room for, must be a power of 2
+#define RECORD_RUNS 1024
+// The size of a saved recording, see record.c
+#define RECORD_HEADER 24
+#define RECORD_SIZE_MAX (RECORD_HEADER + 2 * RECORD_RUNS)
+
+// The pins the hardware abstraction can set
+typedef enum {
+    HAL_PIN_DISPLAY_DC,     // Low for commands, high for data
+    HAL_PIN_DISPLAY_RESET,  // Low resets the display
+    HAL_PIN_DISPLAY_VDD,    // Low turns on the logic supply
+    HAL_PIN_DISPLAY_VBAT    // Low turns on the panel supply
+} Hal_Pin;
+
+// The interrupts the game uses
+typedef enum {
+    HAL_IRQ_TIMER,          // One scheduler tick
+    HAL_IRQ_SPI,            // SPI2 can take another byte for the display
+    HAL_IRQ_BUTTONS         // BTN2-4 changed
+} Hal_Irq;
+
 // Used for holding the highscores
 typedef struct {
     unsigned int* scores;
@@ -55,44 +194,99 @@ void display_string(int line, char *s);
 void display_update(void);
 uint8_t spi_send_recv(uint8_t data);
 void render(void);
+void frame_begin(Layer layer);
+void frame_present(void);
+void render_poll(void);
+bool render_busy(void);
+void render_use_interrupt(void);
 void draw_shape(const Shape *shape);
+void draw_ghost(const Shape *shape);
 void draw_square(const Square *square);
-void draw_grid_pieces(void);
+void draw_row(unsigned const char y, unsigned const short mask);
+void draw_grid_pieces(const Game_State *state);
 void draw_menu(void);
 void draw_borders(void);
 void draw_gameScreen(void);
 void draw_number(unsigned const char num, unsigned const char x, unsigned const char y);
-void draw_score(unsigned int num, unsigned const short y);
+void draw_score(uint32_t num, unsigned const short y);
+void draw_score_cached(Score_Cache *cache, uint32_t num, unsigned const short y);
 void draw_hiscore(void);
 void draw_punctuation(const unsigned char y);
 void animation_start(void);
+bool animation_step(void);
+void draw_animation(void);
+
+
+/* Declare functions from blitter.c */
+void blit(uint8_t *target, const Sprite *sprite, int x, int page, Blit_Op op);
+void blit_region(uint8_t *target, const uint8_t *image, int x, int page, int width, int pages, Blit_Op op);
+void blit_fill(uint8_t *target, int x, int page, int width, int pages, uint8_t value, Blit_Op op);
+void blit_clear(uint8_t *target);
 
+/* Declare functions from scheduler.c */
+bool scheduler_add(Task task, unsigned short period, bool in_isr);
+void scheduler_tick(void);
+bool scheduler_run(void);
+void scheduler_idle(void);
+uint32_t scheduler_ticks(void);
+
+/* Declare functions from hal.c (host/hal.c on a PC) */
+void hal_init(void);
+void hal_pin_set(Hal_Pin pin, bool high);
+unsigned char hal_buttons(void);
+void hal_buttons_init(void);
+uint8_t hal_spi_transfer(uint8_t data);
+void hal_spi_drain(void);
+void hal_spi_send(const uint8_t *data, unsigned short size);
+bool hal_spi_sent(void);
+void hal_spi_use_interrupt(unsigned char priority);
+void hal_timer_init(unsigned int hz);
+bool hal_irq_pending(Hal_Irq irq);
+void hal_irq_clear(Hal_Irq irq);
+void hal_irq_enable(Hal_Irq irq, unsigned char priority);
+
+/* Declare functions from record.c */
+void record_start(uint64_t game_seed, uint32_t time, unsigned char button);
+void record_event(const Input_Event *event);
+void record_stop(uint32_t time);
+bool record_done(void);
+unsigned int record_save(uint8_t *out, unsigned int size);
+
+/* Declare functions from input.c */
+void input_init(void);
+void input_sample(void);
+bool input_pop(Input_Event *event, uint32_t before);
+unsigned char input_state(void);
+
+/* Declare functions from labwork.S */
+void enable_interrupt(void);
+void disable_interrupt(void);
+void sleep_until_interrupt(void);
+
+/* Declare functions from game.c */
+void game_start(Game_State *state, uint64_t seed, uint32_t time);
+bool game_step(Game_State *state, const Game_Input *input);
 
 /* Declare functions used for easier creation of tetris */
+void setGrid(Game_State *state);
 void create_shape(Shape *shape);
 void adapt_piece(Shape *shape);
-void rotate_shape(Shape *shape);
+bool rotate_shape(const Game_State *state, Shape *shape);
+void gravity(Shape *shape);
 void moveSideways(Shape *shape, int way);
-bool belowCheck(Shape *shape); //Is needed, to know when we are at bottom
-bool sideCheck(Shape *shape, int LorR);
-bool rotateCheck(Shape *shape);
-int fullRow(void);
-void randomize_piece(Shape *shape);
+bool collides(const Game_State *state, const Shape *shape, int dx, int dy, unsigned char rot);
+void lock_shape(Game_State *state, const Shape *shape, Row_Range *locked);
+int fullRow(Game_State *state, const Row_Range *rows, unsigned char *cleared);
+int drop_distance(const Game_State *state, const Shape *shape);
+void randomize_piece(Game_State *state, Shape *shape);
 
 /* Declare functions from helper.c */
-unsigned int pow(unsigned const char base, unsigned char exponent);
+uint32_t bcd_add(uint32_t a, uint32_t b);
+uint32_t bcd_from_binary(uint32_t num);
 /*char *itoaconv(int num);*/
-/*void quicksleep(int cyc);*/
-
-// Random
-typedef struct {
-    uint64_t state;
-    uint64_t inc;
-} pcg32_random_t;
+void quicksleep(int cyc);
 
 uint32_t pcg32_random_r(pcg32_random_t* rng);
-// Make this variable global to we can seed it
-extern pcg32_random_t rng;
 
 /* Declare display_debug - a function to help debugging.
 
@@ -109,24 +303,29 @@ extern pcg32_random_t rng;
 void display_debug( volatile int * const addr );
 
 /* Game over death scree font*/
-extern const uint8_t const game_over_font[512]; 
+extern const uint8_t game_over_font[512]; 
 /* More stuff to game display*/
-extern const uint8_t const gameFont[512];
+extern const uint8_t gameFont[512];
 /* Sexy menu */
-extern const uint8_t const menuFont[512];
+extern const uint8_t menuFont[512];
 /* Score font */
-extern const uint8_t const numFont[5*2*10];
+extern const uint8_t numFont[5*2*10];
 // "HISCORE" text
-extern const uint8_t const highscoreFont[8*4];
+extern const uint8_t highscoreFont[8*4];
+/* Gravity of each level */
+extern const uint32_t gravityTable[GRAVITY_LEVELS];
+/* A row of squares as page bytes */
+extern const uint32_t rowFont[2*32];
 /* Declare bitmap array containing font */
-extern const uint8_t const font[128*8];
+extern const uint8_t font[128*8];
 /* Declare bitmap array containing icon */
-extern const uint8_t const icon[128];
+extern const uint8_t icon[128];
 /* Declare text buffer for display output */
 extern char textbuffer[4][16];
 
 /* Game specific declarations */
 void update();
 void init();
+void game_seed(uint64_t value);
 
 #endif /* end of include guard: DECLARATION_H_URHXV5O2 */
@@ -13,27 +13,76 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"    /* Declarations of project specific functions */
 #include <stdbool.h>    // bool
 
-// Declare static buffer for the screen
-static uint8_t buffer[512] = {0};
-
-/* Declare a helper function which is local to this file */
+// Declare two static buffers for the screen, 4 * 128 bytes each.
+// They're made of words so they can be cleared a word at a time.
+static uint32_t frames[2][128] = {{0}};
+// The back buffer, every draw function puts its data here
+static uint8_t *buffer = (uint8_t *) frames[0];
+// The front buffer is what the screen is showing, it's the one being
+// sent while the next frame is drawn to the back buffer
+static uint8_t *front = (uint8_t *) frames[1];
+// Cleared when something else has written to the screen
+static bool front_valid = false;
+// The background every frame starts from, it only changes with the screen
+static uint32_t layer_cache[128] = {0};
+// Which background is in the cache and which one the frame started from
+static Layer cached_layer = LAYER_BLANK;
+static Layer current_layer = LAYER_BLANK;
+
+/* Declare helper functions which are local to this file */
 static void num32asc(char *s, int);
-
-#define DISPLAY_CHANGE_TO_COMMAND_MODE (PORTFCLR = 0x10)
-#define DISPLAY_CHANGE_TO_DATA_MODE (PORTFSET = 0x10)
-
-#define DISPLAY_ACTIVATE_RESET (PORTGCLR = 0x200)
-#define DISPLAY_DO_NOT_RESET (PORTGSET = 0x200)
-
-#define DISPLAY_ACTIVATE_VDD (PORTFCLR = 0x40)
-#define DISPLAY_ACTIVATE_VBAT (PORTFCLR = 0x20)
-
-#define DISPLAY_TURN_OFF_VDD (PORTFSET = 0x40)
-#define DISPLAY_TURN_OFF_VBAT (PORTFSET = 0x20)
+static void render_wait(void);
+
+#define DISPLAY_CHANGE_TO_COMMAND_MODE hal_pin_set(HAL_PIN_DISPLAY_DC, false)
+#define DISPLAY_CHANGE_TO_DATA_MODE hal_pin_set(HAL_PIN_DISPLAY_DC, true)
+
+#define DISPLAY_ACTIVATE_RESET hal_pin_set(HAL_PIN_DISPLAY_RESET, false)
+#define DISPLAY_DO_NOT_RESET hal_pin_set(HAL_PIN_DISPLAY_RESET, true)
+
+#define DISPLAY_ACTIVATE_VDD hal_pin_set(HAL_PIN_DISPLAY_VDD, false)
+#define DISPLAY_ACTIVATE_VBAT hal_pin_set(HAL_PIN_DISPLAY_VBAT, false)
+
+#define DISPLAY_TURN_OFF_VDD hal_pin_set(HAL_PIN_DISPLAY_VDD, true)
+#define DISPLAY_TURN_OFF_VBAT hal_pin_set(HAL_PIN_DISPLAY_VBAT, true)
+
+// SSD1306 commands (see the SSD1306 datasheet), the ones with
+// arguments are followed by that many bytes in command mode
+#define SSD1306_ADDRESSING_MODE 0x20    // 1 arg: how the address moves after data
+#define SSD1306_HORIZONTAL 0x00         // Column first, then wrap to the next page
+#define SSD1306_COLUMN_ADDRESS 0x21     // 2 args: first and last column of the window
+#define SSD1306_PAGE_ADDRESS 0x22       // 2 args: first and last page of the window
+#define SSD1306_CHARGE_PUMP 0x8D        // 1 arg: 0x14 turns it on
+#define SSD1306_PRECHARGE 0xD9          // 1 arg: precharge period
+#define SSD1306_SEGMENT_REMAP 0xA1      // Column 127 is SEG0 (flips x)
+#define SSD1306_COM_SCAN_REVERSE 0xC8   // Scan from COM[N-1] to COM0 (flips y)
+#define SSD1306_COM_PINS 0xDA           // 1 arg: COM pin configuration
+#define SSD1306_DISPLAY_OFF 0xAE
+#define SSD1306_DISPLAY_ON 0xAF
+// Bytes it takes to set a window
+#define SSD1306_WINDOW_COST 6
+
+// A rectangle on the screen, the data sent after it's set
+// fills it from the left to the right and then page by page
+typedef struct {
+    unsigned char first;
+    unsigned char last;
+    unsigned char page_first;
+    unsigned char page_last;
+} Window;
+
+// The windows of the frame that are waiting to be sent.
+// Each window is one burst of data and each page of it one block.
+static Window bursts[4];
+static unsigned char burst_count;
+static volatile unsigned char burst_next;
+static volatile unsigned char burst_page;
+// Set while a frame is on its way to the screen
+static volatile bool transfer_busy = false;
+// Set when the SPI2 interrupt moves the transfer along instead of polling
+static bool irq_driven = false;
 
 /**
  * @brief A function to help debugging.
@@ -50,7 +99,7 @@ static void num32asc(char *s, int);
 void display_debug(volatile int *const addr) {
     display_string( 1, "Addr" );
     display_string( 2, "Data" );
-    num32asc( &textbuffer[1][6], (int) addr );
+    num32asc( &textbuffer[1][6], (int) (uintptr_t) addr );
     num32asc( &textbuffer[2][6], *addr );
     display_update();
 }
@@ -59,68 +108,110 @@ void display_debug(volatile int *const addr) {
  * SPI2 helper function to determine if the interface is ready.
  */
 uint8_t spi_send_recv(uint8_t data) {
-    while(!(SPI2STAT & 0x08));
-    SPI2BUF = data;
-    while(!(SPI2STAT & 1));
-    return SPI2BUF;
-}
-
-static uint8_t buffer_copy[512];
-
-/**
- * Taking down the blocks and drawing up the menu
- */
-static void animation_to_menu(void) {
-    int i, j, v, z;
-    for(i = 0; i < 128; i+=4)
-        for(j = 3; j > -1; j--){
-            for(z = 0; z < 1000000 / 4; z++);  // Small delay
-            buffer_copy[i + j * 128]         = 0;
-            buffer_copy[i + j * 128]        |= menuFont[i+j * 128];
-            buffer_copy[i + j * 128+1]       = 0;
-            buffer_copy[i + j * 128+1]      |= menuFont[i+j * 128+1];
-            buffer_copy[i + j * 128+2]       = 0;
-            buffer_copy[i + j * 128+2]      |= menuFont[i+j * 128+2];
-            buffer_copy[i + j * 128+3]       = 0;
-            buffer_copy[i + j * 128+3]      |= menuFont[i+j * 128+3];
-            for(v = 0; v < 512; v++)//To draw everything up with the added blocks
-                buffer[v] |= buffer_copy[v];
-            render();
-        }
+    return hal_spi_transfer(data);
 }
 
+// What the animation has built up so far.
+// Made of words so the blitter can use it
+static uint32_t buffer_copy[128];
+
+// One part of an animation. The screen is wiped a 4 column strip at a
+// time, a page of a strip every step, from an image or it just waits.
+typedef struct {
+    const uint8_t *image;   // Where the strips come from, 0 to wait
+    bool from_right;        // From the right and the top page down, otherwise from the left and the bottom up
+    bool invert;            // Strips that aren't solid are inverted and the solid ones put on top
+    unsigned short steps;   // 128 to wipe the whole screen
+} Keyframe;
+
+// Build up the game over blocks across the screen, wait and take them
+// down again with the menu
+static const Keyframe keyframes[] = {
+    { game_over_font, true, true, 128 },
+    { 0, false, false, 60 },
+    { menuFont, false, false, 128 }
+};
+#define KEYFRAME_COUNT (sizeof(keyframes) / sizeof(keyframes[0]))
+
+static unsigned char keyframe = KEYFRAME_COUNT;
+static unsigned short step;
+
 /**
- * Build up block across the screen. From the bottom up.
+ * Starts the animation from what's in the back buffer right now.
  */
 void animation_start(void) {
-    int i, j, v, z;
-    for(i = 0; i < 512; i++)//Copy everything
-        buffer_copy[i] = buffer[i];
-    for(i = 127; i > -1; i-=4)
-        for(j = 0; j < 4; j++){//We may want a delay here so you can see the changes
-            for(z = 0; z < 1000000 / 4; z++);  // Small delay
-            if(game_over_font[i + j * 128] < 255){
-              buffer_copy[i + j * 128]  = 0;
-              buffer_copy[i + j * 128]     |= ~ game_over_font[i + j * 128];
-              buffer_copy[i + j * 128 - 1] = 0;
-              buffer_copy[i + j * 128 - 1] |= ~ game_over_font[i + j * 128 - 1];
-              buffer_copy[i + j * 128 - 2] = 0;
-              buffer_copy[i + j * 128 - 2] |= ~ game_over_font[i + j * 128 - 2];
-              buffer_copy[i + j * 128 - 3] = 0;
-              buffer_copy[i + j * 128 - 3] |= ~ game_over_font[i + j * 128 - 3];
-            }
-            else{
-              buffer_copy[i + j * 128]     |= game_over_font[i + j * 128];
-              buffer_copy[i + j * 128 - 1] |= game_over_font[i + j * 128 - 1];
-              buffer_copy[i + j * 128 - 2] |= game_over_font[i + j * 128 - 2];
-              buffer_copy[i + j * 128 - 3] |= game_over_font[i + j * 128 - 3];
-            }
-            for(v = 0; v < 512; v++)//To draw everything up with the added blocks
-                buffer[v] |= buffer_copy[v];
-            render();
+    blit_region((uint8_t *) buffer_copy, buffer, 0, 0, 128, 4, BLIT_COPY);
+    keyframe = 0;
+    step = 0;
+}
+
+/**
+ * Takes the animation one step further, only the strip of this step is
+ * changed. Called every ANIMATION_PERIOD by the game.
+ *
+ * @return false when the animation is over
+ */
+bool animation_step(void) {
+    uint8_t *copy = (uint8_t *) buffer_copy;
+    const Keyframe *key;
+    int x, page;
+
+    if (keyframe == KEYFRAME_COUNT)
+        return false;
+
+    key = &keyframes[keyframe];
+    if (key->image) {
+        if (key->from_right) {
+            x = 124 - step / 4 * 4;
+            page = step % 4;
+        } else {
+            x = step / 4 * 4;
+            page = 3 - step % 4;
         }
-    for(z = 0; z < 1000000; z++);
-    animation_to_menu();
+
+        if (!key->invert)
+            blit_region(copy, key->image, x, page, 4, 1, BLIT_COPY);
+        else if (key->image[page*128 + x + 3] < 255) {
+            // The inverted font, copy it and flip every pixel
+            blit_region(copy, key->image, x, page, 4, 1, BLIT_COPY);
+            blit_fill(copy, x, page, 4, 1, 255, BLIT_XOR);
+        }
+        else
+            blit_region(copy, key->image, x, page, 4, 1, BLIT_OR);
+    }
+
+    if (++step == key->steps) {
+        step = 0;
+        keyframe++;
+    }
+    return keyframe < KEYFRAME_COUNT;
+}
+
+/**
+ * Puts the animation in the back buffer. Since only one strip changes
+ * every step only that strip differs from the last frame and is sent.
+ */
+void draw_animation(void) {
+    blit_region(buffer, (uint8_t *) buffer_copy, 0, 0, 128, 4, BLIT_COPY);
+}
+
+/**
+ * Sets the window on the screen that the following data goes to and
+ * leaves the screen in data mode.
+ *
+ * @param [in] window The columns and pages of the window
+ */
+static void display_window(const Window *window) {
+    DISPLAY_CHANGE_TO_COMMAND_MODE;
+
+    spi_send_recv(SSD1306_COLUMN_ADDRESS);
+    spi_send_recv(window->first);
+    spi_send_recv(window->last);
+    spi_send_recv(SSD1306_PAGE_ADDRESS);
+    spi_send_recv(window->page_first);
+    spi_send_recv(window->page_last);
+
+    DISPLAY_CHANGE_TO_DATA_MODE;
 }
 
 /**
@@ -128,33 +219,43 @@ void animation_start(void) {
  * in this order the screen could be damaged!
  */
 void display_init(void) {
+    const Window full = { 0, 127, 0, 3 };
+
     DISPLAY_CHANGE_TO_COMMAND_MODE;
     quicksleep(10);
     DISPLAY_ACTIVATE_VDD;
     quicksleep(1000000);
 
-    spi_send_recv(0xAE);
+    spi_send_recv(SSD1306_DISPLAY_OFF);
     DISPLAY_ACTIVATE_RESET;
     quicksleep(10);
     DISPLAY_DO_NOT_RESET;
     quicksleep(10);
 
-    spi_send_recv(0x8D);
+    spi_send_recv(SSD1306_CHARGE_PUMP);
     spi_send_recv(0x14);
 
-    spi_send_recv(0xD9);
+    spi_send_recv(SSD1306_PRECHARGE);
     spi_send_recv(0xF1);
 
     DISPLAY_ACTIVATE_VBAT;
     quicksleep(10000000);
 
-    spi_send_recv(0xA1);
-    spi_send_recv(0xC8);
+    // Put the origin in the right corner
+    spi_send_recv(SSD1306_SEGMENT_REMAP);
+    spi_send_recv(SSD1306_COM_SCAN_REVERSE);
 
-    spi_send_recv(0xDA);
+    // Sequential COM pins (bit 4 clear) and COM left/right remap on (bit 5)
+    spi_send_recv(SSD1306_COM_PINS);
     spi_send_recv(0x20);
 
-    spi_send_recv(0xAF);
+    // A whole frame can be sent in one go once the window is set
+    spi_send_recv(SSD1306_ADDRESSING_MODE);
+    spi_send_recv(SSD1306_HORIZONTAL);
+
+    spi_send_recv(SSD1306_DISPLAY_ON);
+
+    display_window(&full);
 }
 
 /**
@@ -187,26 +288,22 @@ void display_string(int line, char *s) {
 void display_image(const int x, const uint8_t *data) {
     int page, j;
 
-    // 4 stripes across the display called pages
-    // each stripe is 8 pixels high and can hold 128 bytes
-    for(page = 0; page < 4; page++) {
-        DISPLAY_CHANGE_TO_COMMAND_MODE;
-
-        spi_send_recv(0x22);    // Command to set the page
-        spi_send_recv(page);    // Set the current page
+    // The screen won't match the front buffer anymore
+    front_valid = false;
+    render_wait();
 
-        // Don't really know how these work
-        spi_send_recv(x & 0xF);
-        spi_send_recv(0x10 | ((x >> 4) & 0xF));
-
-        DISPLAY_CHANGE_TO_DATA_MODE;
+    // 4 stripes across the display called pages
+    // each stripe is 8 pixels high and can hold 128 bytes.
+    // The image is 32 columns on each page.
+    const Window window = { x, x + 31, 0, 3 };
+    display_window(&window);
 
+    for(page = 0; page < 4; page++)
         // j is the x axis of the current page
         for(j = 0; j < 32; j++)
             // Each byte sent to this function is a 8 pixel high column on the display
             // the lsb is the top most pixel and the msb is the most bottom pixel
             spi_send_recv(~data[page*32 + j]);
-    }
 }
 
 /**
@@ -225,118 +322,366 @@ void draw_number(unsigned const char num, unsigned const char x, unsigned const
     if (num > 9 || num < 0)
         return;
 
-    unsigned char i;
-    for (i = 0; i < 5; i++)
-        buffer[i + y + (x/2)*128] |= numFont[(num*2 + x % 2)*5 + i];
+    const Sprite digit = { &numFont[(num*2 + x % 2)*5], 5, 1 };
+    blit(buffer, &digit, y, x/2, BLIT_OR);
 }
-
 /**
  * Can draw at most 8 chars long number (99 999 999 is max).
+ * The number is in BCD so every digit is a nibble of it.
  *
- * @param [in] num The number to write
+ * @param [in] num The number to write in BCD
+ * @param [in] y The y coord of the number
  */
-void draw_score(unsigned int num, unsigned const short y) {
+void draw_score(uint32_t num, unsigned const short y) {
     unsigned char i;
     for (i = 0; i < 8; i++)
-        draw_number(num % pow(10, i + 1) / pow(10, i), i, y);
+        draw_number(num >> i*4 & 0xF, i, y);
+}
+
+/**
+ * Same as draw_score() but the digits are kept in a cache and only
+ * the ones that changed are drawn into it again. The cache is then put
+ * on the screen as one sprite.
+ *
+ * @param [in,out] cache The digits of the score that was drawn last
+ * @param [in] num The number to write in BCD
+ * @param [in] y The y coord of the number
+ */
+void draw_score_cached(Score_Cache *cache, uint32_t num, unsigned const short y) {
+    const Sprite sprite = { cache->strip, 5, 4 };
+    unsigned char i, k, digit, mask;
+    const uint8_t *glyph;
+
+    for (i = 0; i < 8; i++) {
+        digit = num >> i*4 & 0xF;
+        if (cache->valid && digit == (cache->score >> i*4 & 0xF))
+            continue;
+
+        // Each digit is on its own half of the page
+        mask = i % 2 ? 0xF0 : 0x0F;
+        glyph = &numFont[(digit*2 + i % 2)*5];
+        for (k = 0; k < 5; k++)
+            cache->strip[(i/2)*5 + k] = (cache->strip[(i/2)*5 + k] & ~mask) | glyph[k];
+    }
+    cache->score = num;
+    cache->valid = true;
+
+    blit(buffer, &sprite, y, 0, BLIT_OR);
 }
 
 /**
  * Draws "HISCORE" at a fixed position.
  */
 void draw_hiscore(void) {
-    unsigned char page, i;
-    for (page = 0; page < 4; page++)
-        for (i = 0; i < 8; i++)
-            buffer[page*128 + i] |= highscoreFont[i + page*8];
+    const Sprite text = { highscoreFont, 8, 4 };
+    blit(buffer, &text, 0, 0, BLIT_OR);
 }
-
 /**
  * Draws punctuation at constant x value.
  *
  * @param [in] y Value where the punctuation shall be drawn.
  */
 void draw_punctuation(const unsigned char y) {
-    buffer[3*128 + y] |= 4;
-    buffer[3*128 + y + 2] |= 4;
+    blit_fill(buffer, y, 3, 1, 1, 4, BLIT_OR);
+    blit_fill(buffer, y + 2, 3, 1, 1, 4, BLIT_OR);
 }
-
 /**
  * Draw the borders
  */
 void draw_borders(void) {
-    int i;
     // Draw the borders
     // Will draw them from the bottom and up
-    for(i = 0; i < 96; i++) {
-        // Draw the right border
-        buffer[127 - i] |= 1;
-        // Draw the left border
-        buffer[511 - i] |= 128;
-    }
-
-    // Go through each page and put a line there
-    for (i = 0; i < 4; i++) {
-        // Draw top
-        buffer[i * 128 + 4*8 - 1] |= 255;
-        // Draw bottom
-        buffer[(i + 1) * 128 - 1] |= 255;
-    }
+    // Draw the right border
+    blit_fill(buffer, 32, 0, 96, 1, 1, BLIT_OR);
+    // Draw the left border
+    blit_fill(buffer, 32, 3, 96, 1, 128, BLIT_OR);
+
+    // Put a line through every page
+    // Draw top
+    blit_fill(buffer, 4*8 - 1, 0, 1, 4, 255, BLIT_OR);
+    // Draw bottom
+    blit_fill(buffer, 127, 0, 1, 4, 255, BLIT_OR);
 }
-
 /**
  * Draw more to game display.
  */
 void draw_gameScreen(void) {
-    int i;
-    for(i = 0; i < 512; i++)
-        buffer[i] |= gameFont[i];
+    blit_region(buffer, gameFont, 0, 0, 128, 4, BLIT_OR);
 }
-
 /**
  * Draw the menu.
  */
 void draw_menu(void){
-    unsigned short i;
+    blit_fill(buffer, 127, 0, 1, 4, 255, BLIT_OR);
+    blit_region(buffer, menuFont, 0, 0, 128, 4, BLIT_OR);
+}
+/**
+ * Waits until the frame is on the screen. The transfer is moved along
+ * from here as well, so it gets there even if the interrupt doesn't
+ * come. The interrupt is kept out while doing that since it calls
+ * render_poll() too.
+ */
+static void render_wait(void) {
+    while (render_busy())
+        if (irq_driven) {
+            disable_interrupt();
+            render_poll();
+            enable_interrupt();
+        } else
+            render_poll();
+}
 
-    for(i = 0; i < 4; i++)
-        buffer[(i + 1) * 128 - 1] |= 255;
+/**
+ * Lets the SPI2 transmit interrupt call render_poll() so the transfer
+ * doesn't need to be polled. Interrupts still need to be turned on.
+ */
+void render_use_interrupt(void) {
+    hal_spi_use_interrupt(4);           // Same priority as the timer
+    irq_driven = true;
+}
 
-    for(i = 0; i < 512; i++)
-        buffer[i] |= menuFont[i];
+/**
+ * Starts sending the next page of the current burst.
+ */
+static void block_start(void) {
+    const Window *window = &bursts[burst_next];
+
+    hal_spi_send(&front[burst_page*128 + window->first], window->last - window->first + 1);
 }
 
 /**
- * This function puts the data from the buffer provided to it and sends it to
- * the screen. The buffer is always 4 * 128 bytes (512 bytes) big.
- * Gets its data from the static buffer.
+ * Sets the window of the next burst with the CPU and starts sending
+ * its first page.
  */
-void render(void) {
-    int page, j;
+static void burst_start(void) {
+    // Let the last byte leave before the D/C line changes, and throw
+    // away what came back
+    hal_spi_drain();
+
+    display_window(&bursts[burst_next]);
+
+    burst_page = bursts[burst_next].page_first;
+    block_start();
+}
+
+/**
+ * Moves the frame transfer along. Gives SPI2 the next byte and starts
+ * the next page or burst when the current one has been sent. Cheap
+ * enough to be called all the time.
+ */
+void render_poll(void) {
+    if (!transfer_busy || !hal_spi_sent())
+        return;
+
+    // The screen is still in data mode between the pages of a burst
+    if (++burst_page <= bursts[burst_next].page_last)
+        block_start();
+    else if (++burst_next < burst_count)
+        burst_start();
+    else
+        transfer_busy = false;
+}
+
+/**
+ * Is there a frame on its way to the screen?
+ */
+bool render_busy(void) {
+    return transfer_busy;
+}
+
+/**
+ * Draws the parts of a screen that never change into the layer cache.
+ * The draw functions are pointed at the cache instead of the back buffer
+ * while this is done.
+ *
+ * @param [in] layer The background to draw
+ */
+static void layer_compose(Layer layer) {
+    uint8_t *back = buffer;
+    unsigned char i;
+
+    buffer = (uint8_t *) layer_cache;
+    blit_clear(buffer);
+    switch(layer) {
+        case LAYER_GAME:
+            draw_gameScreen();
+            draw_borders();
+            break;
+        case LAYER_MENU:
+            draw_menu();
+            break;
+        case LAYER_HISCORE:
+            // Draw "HISCORE" text and the places
+            draw_hiscore();
+            for(i = 0; i < 8; i++) {
+                draw_number(i + 1, 7, 7*2*(i + 1) - 7 + 4);
+                draw_punctuation(7*2*(i + 1) - 7 + 1 + 4);
+            }
+            break;
+        case LAYER_BLANK:
+            break;
+    }
+    buffer = back;
+
+    cached_layer = layer;
+}
+
+/**
+ * Starts a new frame by copying a background to the back buffer, a word
+ * at a time. The background is only drawn the first time it's used
+ * after another one.
+ *
+ * @param [in] layer The background of the new frame
+ */
+void frame_begin(Layer layer) {
+    if (layer != cached_layer)
+        layer_compose(layer);
+    current_layer = layer;
+
+    blit_region(buffer, (uint8_t *) layer_cache, 0, 0, 128, 4, BLIT_COPY);
+}
+
+/**
+ * This function puts the data from the back buffer on the screen.
+ * The buffer is always 4 * 128 bytes (512 bytes) big.
+ * Only the columns that differ from the front buffer are sent. That's
+ * either one window around all of them or one window per page with the
+ * changes on it, whichever is fewer bytes. A full frame is one window
+ * and 512 bytes in a row. The buffers are then flipped and the windows
+ * are sent from the new front buffer a byte at a time so this returns
+ * right away. render_poll() (or the SPI2 interrupt after
+ * render_use_interrupt()) keeps the transfer going and render_busy()
+ * tells when it's done. The next frame can be drawn after frame_begin()
+ * while this one is being sent.
+ */
+void frame_present(void) {
+    int page, first, last;
+    unsigned int separate = 0;
+    Window all = { 127, 0, 3, 0 };
+    uint8_t *flip;
+
+    // The front buffer is being read until the last frame is sent
+    render_wait();
+
+    burst_count = 0;
     // 4 stripes across the display called pages
     // each stripe is 8 pixels high and can hold 128 bytes
     for(page = 0; page < 4; page++) {
-        DISPLAY_CHANGE_TO_COMMAND_MODE;
+        // Find the dirty columns on this page
+        if (front_valid) {
+            for(first = 0; first < 128; first++)
+                if (buffer[page*128 + first] != front[page*128 + first])
+                    break;
+            for(last = 127; last > first; last--)
+                if (buffer[page*128 + last] != front[page*128 + last])
+                    break;
+        } else {
+            first = 0;
+            last = 127;
+        }
 
-        spi_send_recv(0x22);    // Command to set the page
-        spi_send_recv(page);    // Set the current page
+        // Nothing has changed on this page
+        if (first == 128)
+            continue;
+
+        bursts[burst_count].first = first;
+        bursts[burst_count].last = last;
+        bursts[burst_count].page_first = page;
+        bursts[burst_count].page_last = page;
+        burst_count++;
+        separate += SSD1306_WINDOW_COST + last - first + 1;
+
+        // Grow the window around all of the changes
+        if (first < all.first)
+            all.first = first;
+        if (last > all.last)
+            all.last = last;
+        if (page < all.page_first)
+            all.page_first = page;
+        all.page_last = page;
+    }
+    front_valid = true;
 
-        // Don't really know how these work
-        // But they have something to do with the x value from
-        // the left side of the screen
-        spi_send_recv(0x0);
-        spi_send_recv(0x10);
+    // One window is cheaper when the changes line up or cover most of it
+    if (burst_count > 1 && SSD1306_WINDOW_COST + (all.last - all.first + 1) *
+            (all.page_last - all.page_first + 1) <= separate) {
+        bursts[0] = all;
+        burst_count = 1;
+    }
 
-        DISPLAY_CHANGE_TO_DATA_MODE;
+    // Page flip
+    flip = front;
+    front = buffer;
+    buffer = flip;
 
-        // j is the x axis of the current page
-        for(j = 0; j < 128; j++) {
-            // Each byte sent to this function is a 8 pixel high column on the display
-            // the lsb is the top most pixel and the msb is the most bottom pixel
-            spi_send_recv(buffer[page*128 + j]);
-            // Clear the buffer after drawing it
-            buffer[page*128 + j] = 0x0;
-        }
+    if (burst_count == 0)
+        return;
+
+    burst_next = 0;
+    transfer_busy = true;
+    burst_start();
+}
+
+/**
+ * Puts the frame on the screen, waits until it's there and
+ * starts a new one with the same background.
+ */
+void render(void) {
+    frame_present();
+    render_wait();
+    frame_begin(current_layer);
+}
+
+/**
+ * Puts the 3 columns of a row of squares in the buffer.
+ *
+ * @param [in] y The y coord of the row
+ * @param [in] edge The first and last column as a 32 pixel column
+ * @param [in] middle The column between them
+ */
+static void draw_row_columns(unsigned const char y, uint32_t edge, uint32_t middle) {
+    // 0 <= y <= 41 so all 3 columns are on the screen
+    if (y > 41)
+        return;
+
+    int origin = 127 - y*3 - 1;
+    unsigned char page;
+
+    for(page = 0; page < 4; page++) {
+        buffer[page*128 + origin]      |= edge >> page*8;
+        buffer[page*128 + origin-1]    |= middle >> page*8;
+        buffer[page*128 + origin-2]    |= edge >> page*8;
+    }
+}
+
+/**
+ * Draws a row of 3x3 squares at the given y coord. Each square is 3
+ * pixels across the pages, so the whole row is looked up as one 32 pixel
+ * column (4 page bytes) and put in the 3 columns of the row.
+ *
+ * @param [in] y The y coord of the row
+ * @param [in] mask Bit x is set for every square x (0-9) to draw
+ */
+void draw_row(unsigned const char y, unsigned const short mask) {
+    uint32_t column = rowFont[mask & 0x1F] | rowFont[32 + (mask >> 5 & 0x1F)];
+    draw_row_columns(y, column, column);
+}
+
+/**
+ * Draws every square on the grid of a game, a row at a time.
+ *
+ * @param [in] state The game whose grid is drawn
+ */
+void draw_grid_pieces(const Game_State *state) {
+    int y;
+    unsigned short row;
+
+    for(y = 0; y < 32; y++) {
+        // Bit 1-10 of a grid row are the squares, bit 0 and 11 the walls
+        row = state->grid[y + 1] >> 1 & 0x3FF;
+        // Most rows are empty, skip them all at once
+        if (row)
+            draw_row(y, row);
     }
 }
 
@@ -347,95 +692,15 @@ void render(void) {
  * A little bit of abstraction :).
  *
  * @param [in] square The item to draw
- * @param [in] remove Should the item be removed or drawn? (true = remove, false = draw)
  */
 void draw_square(const Square *square) {
     // Is this a valid x or y coord?
     // 0 <= x <= 9
-    // 0 <= y <= 31
-    if (square->x > 9 || square->x < 0 || square->y > 42 || square->y < 0)
+    // 0 <= y <= 41
+    if (square->x > 9)
         return;
 
-    unsigned char page, value;
-    // Hard coded x values (2 and 7 are missing because they
-    // require to pages to render, special cases below has been
-    // created for them).
-    switch(square->x) {
-        case 9:
-            page = 0;
-            value = 14;
-            break;
-        case 8:
-            page = 0;
-            value = 112;
-            break;
-        case 6:
-            page = 1;
-            value = 28;
-            break;
-        case 5:
-            page = 1;
-            value = 224;
-            break;
-        case 4:
-            page = 2;
-            value = 7;
-            break;
-        case 3:
-            page = 2;
-            value = 56;
-            break;
-        case 1:
-            page = 3;
-            value = 14;
-            break;
-        case 0:
-            page = 3;
-            value = 112;
-            break;
-    }
-
-    // Calulcate the y coordinates and put the data in the
-    // display buffer so we can render it
-    // First remove the item from the place it was before
-    // and then add it to its new position
-    int origin;
-    switch(square->x) {
-        case 7:
-            // Draw item at the new position
-            origin = 128 + 127 - square->y*3 - 1;
-            buffer[origin]      |= 3;
-            buffer[origin-1]    |= 3;
-            buffer[origin-2]    |= 3;
-
-            // Draw item at the new position
-            origin = 127 - square->y*3 - 1;
-            buffer[origin]      |= 128;
-            buffer[origin-1]    |= 128;
-            buffer[origin-2]    |= 128;
-            break;
-        case 2:
-            // Draw item at the new position
-            origin = 2*128 + 127 - square->y*3 - 1;
-            buffer[origin]      |= 192;
-            buffer[origin-1]    |= 192;
-            buffer[origin-2]    |= 192;
-
-            // Draw item at the new position
-            origin = 3*128 + 127 - square->y*3 - 1;
-            buffer[origin]      |= 1;
-            buffer[origin-1]    |= 1;
-            buffer[origin-2]    |= 1;
-            break;
-        default:
-            // The page's calculated in the switch statement above
-            // and we just add three lines, the first from the origin
-            // and the second two over it so we get a nice 3x3 triangle
-            origin = page*128 + 127 - square->y*3 - 1;
-            buffer[origin]      |= value;
-            buffer[origin-1]    |= value;
-            buffer[origin-2]    |= value;
-    }
+    draw_row(square->y, 1 << square->x);
 }
 
 /**
@@ -452,21 +717,41 @@ void draw_shape(const Shape *shape) {
 }
 
 /**
- * Don't really know how this one works but it clears the screen
- * of items not being used.
+ * Draws the shape as a ghost, only the 4 corners of every square, to
+ * show where it would land.
+ *
+ * @param [in] shape The shape where it would land
+ */
+void draw_ghost(const Shape *shape) {
+    uint32_t column;
+    int i, x;
+    for(i = 0; i < 4; i++) {
+        x = shape->piece[i].x;
+        if (x > 9)
+            continue;
+
+        column = x < 5 ? rowFont[1 << x] : rowFont[32 + (1 << (x - 5))];
+        // Leave out the pixel in the middle of the square
+        draw_row_columns(shape->piece[i].y, column & ~(column >> 1 & column << 1), 0);
+    }
+}
+
+/**
+ * Writes the text buffer to the screen with the 8x8 font, one line of
+ * 16 chars on each page. Used at start up to clear the screen.
  */
 void display_update(void) {
     int i, j, k;
     int c;
-    for(i = 0; i < 4; i++) {
-        DISPLAY_CHANGE_TO_COMMAND_MODE;
-        spi_send_recv(0x22);
-        spi_send_recv(i);
 
-        spi_send_recv(0x0);
-        spi_send_recv(0x10);
-
-        DISPLAY_CHANGE_TO_DATA_MODE;
+    // The screen won't match the front buffer anymore
+    front_valid = false;
+    render_wait();
+    for(i = 0; i < 4; i++) {
+        // One page at a time since skipped chars would shift
+        // everything after them
+        const Window line = { 0, 127, i, i };
+        display_window(&line);
 
         for(j = 0; j < 16; j++) {
             c = textbuffer[i][j];
@@ -0,0 +1,357 @@
+/**
+* @file    game.c
+* @author  Joel Wachsler (wachsler@kth.se)
+* @author  Marcus Werlinder (werli@kth.se)
+* @date    2016
+* @copyright For copyright and licensing, see file COPYING
+*
+* The rules of the game. Everything about a game is in its Game_State and
+* the only way to change it is game_step(), which takes the game to a
+* later tick with what the player did since the last step. Nothing here
+* reads the buttons, the clock or draws anything, so a game plays the
+* same way every time it gets the same input and any number of games can
+* be played next to each other.
+*/
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "declaration.h"    /* Declarations of project specific functions */
+#include <stdbool.h>        /* To be able to use boolean */
+
+// The buttons that auto repeat in the game (soft drop, right and left),
+// BTN4 (rotate) only does something when it's pressed
+#define BTN_REPEAT 0b0111
+
+// How long a button is held before it starts repeating (delayed auto
+// shift) and the time between the repeats (auto repeat rate), in
+// scheduler ticks. A rate of 0 moves the shape as far as it can go.
+typedef struct {
+    unsigned short delay;
+    unsigned short rate;
+} Auto_Repeat;
+
+// Indexed by the button's bit shifted right once, BTN1, BTN2 and BTN3
+static const Auto_Repeat autoRepeat[3] = {
+    { MS_TO_TICKS(33), MS_TO_TICKS(33) },   // Soft drop
+    { MS_TO_TICKS(170), MS_TO_TICKS(50) },  // Right
+    { MS_TO_TICKS(170), MS_TO_TICKS(50) }   // Left
+};
+
+// How long the shape can rest on something before it's locked, and how
+// many times moving or turning it may start that time over. Reaching a
+// row lower than before gives all the resets back.
+#define LOCK_DELAY MS_TO_TICKS(500)
+#define LOCK_RESETS 15
+
+// Pressing soft drop twice within this many ticks drops the shape all
+// the way down and locks it (hard drop)
+#define HARD_DROP_TAP MS_TO_TICKS(250)
+
+/**
+ * The lowest row any square of the shape is on.
+ */
+static unsigned char shape_bottom(const Shape *shape) {
+    unsigned char i, bottom = shape->piece[0].y;
+    for(i = 1; i < 4; i++)
+        if (shape->piece[i].y < bottom)
+            bottom = shape->piece[i].y;
+    return bottom;
+}
+
+/**
+ * Starts the lock delay over for a new shape.
+ */
+static void shape_spawned(Game_State *state) {
+    state->grounded = false;
+    state->fallen = 0;
+    state->lock_resets = 0;
+    state->lowest_row = shape_bottom(&state->shape);
+}
+
+/**
+ * Called when the shape has moved or turned. Starts the lock delay when
+ * it lands and starts it over when it's moved while resting, as long as
+ * there are resets left.
+ */
+static void shape_moved(Game_State *state) {
+    unsigned char bottom = shape_bottom(&state->shape);
+
+    if (bottom < state->lowest_row) {
+        state->lowest_row = bottom;
+        state->lock_resets = 0;
+    }
+
+    if (!collides(state, &state->shape, 0, -1, 0)) {
+        state->grounded = false;
+        return;
+    }
+
+    if (!state->grounded) {
+        state->grounded = true;
+        state->lock_at = state->time + LOCK_DELAY;
+    } else if (state->lock_resets < LOCK_RESETS) {
+        state->lock_resets++;
+        state->lock_at = state->time + LOCK_DELAY;
+    }
+}
+
+/**
+ * Called when the shape has been locked into the grid. Removes the full
+ * rows among the ones the shape covered, adds the score for them and
+ * brings in the next shape. The game is over if the next shape doesn't
+ * fit.
+ *
+ * @param [in] locked The rows the locked shape covered
+ */
+static void shape_locked(Game_State *state, const Row_Range *locked) {
+    // Original tetris scores
+    unsigned short rows = fullRow(state, locked, state->cleared);
+    unsigned int points = 0;
+    state->pieces++;
+    state->rows += rows;
+    switch(rows) {
+        case 1:
+            points = 40 * (state->level + 1);
+            break;
+        case 2:
+            points = 100 * (state->level + 1);
+            break;
+        case 3:
+            points = 300 * (state->level + 1);
+            break;
+        case 4:
+            points = 1200 * (state->level + 1);
+            break;
+    }
+    if (points)
+        state->score = bcd_add(state->score, bcd_from_binary(points));
+
+    // Original level calulcaton, without the cap at level 9
+    state->level = state->rows / 10;
+
+    state->shape.piece_type = state->next.piece_type;
+    create_shape(&state->shape);
+    // Game over if the new shape can't even fall one step
+    if (collides(state, &state->shape, 0, -1, 0)) {
+        state->over = true;
+        return;
+    }
+
+    randomize_piece(state, &state->next);
+    adapt_piece(&state->next);
+    shape_spawned(state);
+}
+
+/**
+ * Moves the shape for a button.
+ *
+ * @param [in] button The button
+ * @return false if the shape couldn't move
+ */
+static bool game_move(Game_State *state, unsigned char button) {
+    Shape *shape = &state->shape;
+
+    switch(button) {
+        case 1:
+            if (collides(state, shape, 0, -1, 0))
+                return false;
+            gravity(shape);
+            state->score = bcd_add(state->score, 0x10);
+            return true;
+        case 2:
+            if (collides(state, shape, 1, 0, 0)) //Now we want to check if we can actually go to the sides
+                return false;
+            moveSideways(shape, 1);
+            return true;
+        case 4:
+            if (collides(state, shape, -1, 0, 0))
+                return false;
+            moveSideways(shape, -1);
+            return true;
+        case 8:
+            return rotate_shape(state, shape);
+    }
+    return false;
+}
+
+/**
+ * Drops the shape as far as it can go and locks it.
+ */
+static void hard_drop(Game_State *state) {
+    Row_Range locked;
+    int i, distance = drop_distance(state, &state->shape);
+
+    for(i = 0; i < 4; i++)
+        state->shape.piece[i].y -= distance;
+    // Twice the points of a soft drop for every row
+    state->score = bcd_add(state->score, bcd_from_binary(20 * distance));
+
+    lock_shape(state, &state->shape, &locked);
+    shape_locked(state, &locked);
+}
+
+/**
+ * Moves the shape for a pressed button and starts its auto repeat.
+ * Soft drop pressed twice quickly is a hard drop.
+ *
+ * @return false if nothing happened
+ */
+static bool game_press(Game_State *state, unsigned char button) {
+    bool moved;
+
+    if (button == 1) {
+        if (state->time - state->soft_drop_at < HARD_DROP_TAP) {
+            // So a third tap isn't taken as another double tap
+            state->soft_drop_at = state->time - HARD_DROP_TAP;
+            state->repeating &= ~1;
+            hard_drop(state);
+            return true;
+        }
+        state->soft_drop_at = state->time;
+    }
+
+    moved = game_move(state, button);
+    if (moved)
+        shape_moved(state);
+
+    if (button & BTN_REPEAT) {
+        state->repeating |= button;
+        state->repeat_at[button >> 1] = state->time + autoRepeat[button >> 1].delay;
+    }
+    return moved;
+}
+
+/**
+ * Repeats the held buttons. Every repeat since the last step is done,
+ * so the rate isn't limited by how often the game is stepped.
+ *
+ * @return false if nothing moved
+ */
+static bool game_repeat(Game_State *state, unsigned char held) {
+    uint32_t now = state->time;
+    unsigned char i;
+    bool moved = false;
+
+    state->repeating &= held;
+    for(i = 0; i < 3; i++) {
+        if (!(state->repeating & 1 << i))
+            continue;
+
+        while((int32_t) (now - state->repeat_at[i]) >= 0) {
+            state->time = state->repeat_at[i];
+            if (!game_move(state, 1 << i)) {
+                // Try again next step, without catching up on the
+                // repeats it was blocked for
+                state->repeat_at[i] = now;
+                break;
+            }
+            shape_moved(state);
+            moved = true;
+            state->repeat_at[i] += autoRepeat[i].rate;
+        }
+    }
+    state->time = now;
+    return moved;
+}
+
+/**
+ * Lets the shape fall, called every step. A resting shape is locked
+ * when the lock delay is over.
+ *
+ * @return false if nothing moved
+ */
+static bool game_fall(Game_State *state) {
+    Row_Range locked;
+    unsigned int level = state->level;
+    bool moved = false;
+
+    if (state->grounded) {
+        if ((int32_t) (state->time - state->lock_at) < 0)
+            return false;
+
+        lock_shape(state, &state->shape, &locked);
+        shape_locked(state, &locked);
+        return true;
+    }
+
+    state->fallen += gravityTable[level < GRAVITY_LEVELS ? level : GRAVITY_LEVELS - 1];
+    for(; state->fallen >= GRAVITY_ONE; state->fallen -= GRAVITY_ONE) {
+        if (collides(state, &state->shape, 0, -1, 0)) {
+            state->fallen = 0;
+            break;
+        }
+        gravity(&state->shape);
+        shape_moved(state);
+        moved = true;
+    }
+    return moved;
+}
+
+/**
+ * Starts a new game.
+ *
+ * @param [out] state The game
+ * @param [in] seed Decides which pieces come, the same seed gives the
+ *                  same pieces
+ * @param [in] time The scheduler tick the game starts at
+ */
+void game_start(Game_State *state, uint64_t seed, uint32_t time) {
+    Game_State start = {0};
+
+    *state = start;
+    state->time = time;
+
+    // Set seed
+    state->rng.state = 0U;
+    state->rng.inc = (seed << 1u) | 1u;
+    pcg32_random_r(&state->rng);
+    state->rng.state += seed;
+    pcg32_random_r(&state->rng);
+
+    setGrid(state);//To set the borders in the grid to true
+
+    randomize_piece(state, &state->shape);
+    create_shape(&state->shape);
+    randomize_piece(state, &state->next);
+    adapt_piece(&state->next);
+    shape_spawned(state);
+    state->soft_drop_at = time - HARD_DROP_TAP;
+}
+
+/**
+ * Takes the game to input->time. The presses are acted on first, in the
+ * order and at the time they were pressed, then the held buttons are
+ * repeated and the shape falls. Once the game is over it stays where it
+ * is.
+ *
+ * @param [in,out] state The game
+ * @param [in] input What the player did since the last step
+ * @return true if anything that is drawn has changed
+ */
+bool game_step(Game_State *state, const Game_Input *input) {
+    unsigned char pressed = input->pressed;
+    unsigned char i, first;
+    bool changed = false;
+
+    while(pressed && !state->over) {
+        // The earliest press left
+        first = 4;
+        for(i = 0; i < 4; i++)
+            if (pressed & 1 << i &&
+                    (first == 4 || (int32_t) (input->pressed_at[i] - input->pressed_at[first]) < 0))
+                first = i;
+        pressed &= ~(1 << first);
+
+        state->time = input->pressed_at[first];
+        if (game_press(state, 1 << first))
+            changed = true;
+    }
+    if (state->over)
+        return true;
+
+    state->time = input->time;
+    if (game_repeat(state, input->held))
+        changed = true;
+    if (game_fall(state))
+        changed = true;
+    return changed;
+}
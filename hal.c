@@ -0,0 +1,257 @@
+/**
+ * @file    hal.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * The only file (with main.c) that touches the PIC32 registers. The
+ * rest of the game goes through these functions for the pins, SPI2,
+ * timer 2 and the interrupt flags, so it can be built for a PC against
+ * the simulated registers in host/hal.c instead.
+ *
+ * The PIC32MX320F128H has no DMA controller, so blocks for the display
+ * are pumped out a byte at a time by the CPU. Each call to hal_spi_sent()
+ * moves the block along, either from a polling loop or from the SPI2
+ * transmit interrupt that is raised every time SPI2 can take a byte.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
+#include "declaration.h"    /* Declarations of project specific functions */
+
+#define PBCLK 40000000          // Peripheral bus clock, the 80 MHz SYSCLK over PBDIV 2
+#define T2_PRESCALE 64          // 40 MHz / 64 is 625 kHz, a whole number of counts per ms
+
+#define SPI_BUSY 0x800          // SPIxSTAT bit SPIBUSY, still shifting out
+#define SPI_TBE 0x08            // SPIxSTAT bit SPITBE, transmit buffer empty
+#define SPI_RBF 0x01            // SPIxSTAT bit SPIRBF, receive buffer full
+#define SPI_ROV 0x40            // SPIxSTAT bit SPIROV, receive overflow
+
+// Change notification pins of BTN2, BTN3 and BTN4
+#define CN_BUTTONS (1 << 14 | 1 << 15 | 1 << 16)
+
+// The block being sent to the display
+static const uint8_t *volatile tx_data;
+static volatile unsigned short tx_left;
+static volatile bool tx_busy = false;
+// Let the transmit interrupt through while a block is being sent
+static bool tx_irq = false;
+
+// The display pins, all on port F except reset which is on port G
+static const uint32_t pin_bits[] = {
+    0x10,   // HAL_PIN_DISPLAY_DC
+    0x200,  // HAL_PIN_DISPLAY_RESET
+    0x40,   // HAL_PIN_DISPLAY_VDD
+    0x20    // HAL_PIN_DISPLAY_VBAT
+};
+
+// Where each interrupt's flag, enable and priority bits are
+typedef struct {
+    unsigned char reg;      // IFS and IEC register
+    uint32_t bit;           // Bit in IFS and IEC
+    unsigned char ipc;      // IPC register
+    unsigned char shift;    // Where the priority is in it
+} Irq_Bits;
+
+static const Irq_Bits irqs[] = {
+    { 0, 0x100, 2, 2 },     // HAL_IRQ_TIMER, timer 2
+    { 1, 0x40, 7, 26 },     // HAL_IRQ_SPI, SPI2 transmit (IRQ 38, vector 31)
+    { 1, 0x1, 6, 18 }       // HAL_IRQ_BUTTONS, change notification
+};
+
+/**
+ * Sets up the clock, the pins and SPI2 for the display.
+ */
+void hal_init(void) {
+    /* Set up peripheral bus clock */
+    /* OSCCONbits.PBDIV = 1; */
+    OSCCONCLR = 0x100000; /* clear PBDIV bit 1 */
+    OSCCONSET = 0x080000; /* set PBDIV bit 0 */
+
+    /* Set up output pins */
+    AD1PCFG = 0xFFFF;
+    ODCE = 0x0;
+    TRISECLR = 0xFF;
+    PORTE = 0x0;
+
+    /* Output pins for display signals */
+    PORTF = 0xFFFF;
+    PORTG = (1 << 9);
+    ODCF = 0x0;
+    ODCG = 0x0;
+    TRISFCLR = 0x70;
+    TRISGCLR = 0x200;
+
+    /* Set up input pins */
+    TRISDSET = (1 << 8);
+    TRISFSET = (1 << 1);
+
+    /* Set up SPI as master */
+    SPI2CON = 0;
+    SPI2BRG = 4;
+    /* SPI2STAT bit SPIROV = 0; */
+    SPI2STATCLR = 0x40;
+    /* SPI2CON bit CKP = 1; */
+    SPI2CONSET = 0x40;
+    /* SPI2CON bit MSTEN = 1; */
+    SPI2CONSET = 0x20;
+    /* SPI2CON bit ON = 1; */
+    SPI2CONSET = 0x8000;
+}
+
+/**
+ * Sets a display pin high or low.
+ *
+ * @param [in] pin The pin
+ * @param [in] high true for high
+ */
+void hal_pin_set(Hal_Pin pin, bool high) {
+    if (pin == HAL_PIN_DISPLAY_RESET) {
+        if (high)
+            PORTGSET = pin_bits[pin];
+        else
+            PORTGCLR = pin_bits[pin];
+    } else if (high)
+        PORTFSET = pin_bits[pin];
+    else
+        PORTFCLR = pin_bits[pin];
+}
+
+/**
+ * The buttons that are held down, BTN1 in bit 0 to BTN4 in bit 3.
+ */
+unsigned char hal_buttons(void) {
+    return (PORTD >> 4 & 0b1110) | (PORTF >> 1 & 0x01);
+}
+
+/**
+ * Makes the button pins inputs and turns on change notification for
+ * BTN2-4. BTN1 (RF1) has no change notification.
+ */
+void hal_buttons_init(void) {
+    // Init port D
+    // Set bits 11 through 5 to 1 (input)
+    TRISDSET = 0b1111111 << 5;
+
+    CNCON = 0x8000;         // Change notification on
+    CNEN = CN_BUTTONS;
+    (void) PORTD;           // Reading the port clears the mismatch
+}
+
+/**
+ * Sends a byte on SPI2 and waits for the byte that comes back.
+ */
+uint8_t hal_spi_transfer(uint8_t data) {
+    while(!(SPI2STAT & SPI_TBE));
+    SPI2BUF = data;
+    while(!(SPI2STAT & 1));
+    return SPI2BUF;
+}
+
+/**
+ * Waits until the last byte has left SPI2 and throws away what came back
+ * while a block was being sent.
+ */
+void hal_spi_drain(void) {
+    while(SPI2STAT & SPI_BUSY);
+    while(SPI2STAT & SPI_RBF)
+        (void) SPI2BUF;
+    SPI2STATCLR = SPI_ROV;
+}
+
+/**
+ * Gives SPI2 the next byte of the block if it has room for it. What
+ * comes back is thrown away so the receive buffer doesn't overflow.
+ */
+static void tx_pump(void) {
+    while(SPI2STAT & SPI_RBF)
+        (void) SPI2BUF;
+
+    if (tx_left && SPI2STAT & SPI_TBE) {
+        SPI2BUF = *tx_data++;
+        tx_left--;
+    }
+}
+
+/**
+ * Starts sending a block, the first byte goes right away.
+ *
+ * @param [in] data The block, must stay put until it's sent
+ * @param [in] size How many bytes, at least 1
+ */
+void hal_spi_send(const uint8_t *data, unsigned short size) {
+    tx_data = data;
+    tx_left = size;
+    tx_busy = true;
+    tx_pump();
+    if (tx_irq)
+        IECSET(irqs[HAL_IRQ_SPI].reg) = irqs[HAL_IRQ_SPI].bit;
+}
+
+/**
+ * Moves the block along and tells when all of it has been given to
+ * SPI2 (the last byte may still be shifting out). True only once for
+ * every block. Nothing but SPI2 itself has to happen for a block to
+ * be sent, so calling this often enough always gets there.
+ */
+bool hal_spi_sent(void) {
+    if (!tx_busy)
+        return false;
+
+    tx_pump();
+    if (tx_left)
+        return false;
+
+    // SPI2 keeps its buffer empty from now on, which would raise the
+    // interrupt over and over
+    if (tx_irq)
+        IECCLR(irqs[HAL_IRQ_SPI].reg) = irqs[HAL_IRQ_SPI].bit;
+    tx_busy = false;
+    return true;
+}
+
+/**
+ * Lets the SPI2 transmit interrupt through while a block is being sent.
+ * It's only let through then, hal_irq_enable() would let it through
+ * for good. Interrupts still need to be turned on.
+ *
+ * @param [in] priority The priority of the interrupt
+ */
+void hal_spi_use_interrupt(unsigned char priority) {
+    IPCSET(irqs[HAL_IRQ_SPI].ipc) = priority << irqs[HAL_IRQ_SPI].shift;
+    tx_irq = true;
+    if (tx_busy)
+        IECSET(irqs[HAL_IRQ_SPI].reg) = irqs[HAL_IRQ_SPI].bit;
+}
+
+/**
+ * Starts timer 2 so its flag is raised hz times a second. The timer runs
+ * off PBCLK and counts from 0 to PR2, so a period is PR2 + 1 counts.
+ */
+void hal_timer_init(unsigned int hz) {
+    T2CON = 0x60;                           // Stop timer and set prescale to 1:64
+    PR2 = PBCLK / T2_PRESCALE / hz - 1;     // Set the period
+    IFSCLR(0) = 0x100;                      // Clear the timer flag
+    T2CONSET = 0x8000;                      // Start the timer (the bit to start the timer's located at bit 15)
+}
+
+/**
+ * Is the interrupt's flag raised?
+ */
+bool hal_irq_pending(Hal_Irq irq) {
+    return IFS(irqs[irq].reg) & irqs[irq].bit;
+}
+
+void hal_irq_clear(Hal_Irq irq) {
+    IFSCLR(irqs[irq].reg) = irqs[irq].bit;
+}
+
+/**
+ * Lets the interrupt through with the given priority. Interrupts still
+ * need to be turned on.
+ */
+void hal_irq_enable(Hal_Irq irq, unsigned char priority) {
+    IPCSET(irqs[irq].ipc) = priority << irqs[irq].shift;
+    IECSET(irqs[irq].reg) = irqs[irq].bit;
+}
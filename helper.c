@@ -15,16 +15,49 @@
 #include "declaration.h"
 
 /**
- * Pow doesn't exist so let's create one!
+ * Adds two packed BCD numbers (one decimal digit per nibble) without
+ * dividing. 6 is added to every digit first so the ones that go past 9
+ * carry into the next nibble, then the 6 is taken back from the digits
+ * that didn't carry. Saturates at 99 999 999.
  *
- * @param [in] base The base of the number.
- * @param [in] exponent The exponent.
+ * @param [in] a The first number in BCD
+ * @param [in] b The second number in BCD
+ * @return a + b in BCD
  */
-unsigned int pow(unsigned const char base, unsigned char exponent) {
-    unsigned int result = 1;
-    for(;exponent > 0; exponent--)
-        result *= base;
-    return result;
+uint32_t bcd_add(uint32_t a, uint32_t b) {
+    uint32_t t1 = a + 0x06666666;
+    uint32_t t2 = t1 + b;
+    uint32_t t3 = t1 ^ b;
+    // The bits where a carry came in from the nibble below
+    uint32_t t4 = t2 ^ t3;
+    // Digits that didn't carry, take the 6 back from them
+    uint32_t t5 = ~t4 & 0x11111110;
+    uint32_t sum = t2 - ((t5 >> 2) | (t5 >> 3));
+
+    // The top digit has nowhere to carry to
+    if (sum < a || sum >> 28 > 9)
+        return 0x99999999;
+    return sum;
+}
+
+/**
+ * Converts a binary number to packed BCD with shift and add 3 (double
+ * dabble), so no division is needed.
+ *
+ * @param [in] num The number to convert, at most 99 999 999
+ * @return num in BCD
+ */
+uint32_t bcd_from_binary(uint32_t num) {
+    uint32_t bcd = 0;
+    int i, digit;
+    for(i = 31; i >= 0; i--) {
+        // Every digit that is 5 or more becomes 10 or more after the shift
+        for(digit = 0; digit < 32; digit += 4)
+            if ((bcd >> digit & 0xF) >= 5)
+                bcd += 3 << digit;
+        bcd = bcd << 1 | (num >> i & 1);
+    }
+    return bcd;
 }
 
 /**
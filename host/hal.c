@@ -0,0 +1,176 @@
+/**
+ * @file    hal.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * The hal.c functions for a PC. The hardware is a register file in
+ * memory and nothing takes any time. SPI2 sends a byte as soon as it's
+ * written, so its transmit buffer is always empty and its interrupt is
+ * raised again right after every byte, and sleeping until the next
+ * interrupt moves the timer one period forward. So the game runs as
+ * fast as the PC can run it, with the same code and the same order of
+ * events as on the board.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "host.h"           /* The simulated registers */
+
+Host_Registers host;
+
+/**
+ * Sends a byte to the display.
+ */
+static void spi_out(uint8_t data) {
+    host.spi_bytes++;
+    if (host.spi_sink)
+        host.spi_sink(data, host.pins & 1 << HAL_PIN_DISPLAY_DC);
+}
+
+/**
+ * Gives SPI2 the next byte of the block, which empties the transmit
+ * buffer again and raises its flag.
+ */
+static void tx_pump(void) {
+    if (!host.tx_left)
+        return;
+
+    spi_out(*host.tx_data++);
+    host.tx_left--;
+    host.irq_flags |= 1 << HAL_IRQ_SPI;
+}
+
+/**
+ * Takes every interrupt that is raised and let through, and the ones
+ * they lead to, if the core takes interrupts. Like on the board they
+ * don't nest.
+ */
+void host_run_interrupts(void) {
+    if (host.in_isr)
+        return;
+
+    for(;;) {
+        if (!host.interrupts_on || !(host.irq_flags & host.irq_enabled))
+            return;
+
+        host.in_isr = true;
+        user_isr();
+        host.in_isr = false;
+    }
+}
+
+/**
+ * Changes the held buttons. A change of BTN2-4 raises the change
+ * notification flag.
+ *
+ * @param [in] buttons BTN1 in bit 0 to BTN4 in bit 3
+ */
+void host_set_buttons(unsigned char buttons) {
+    if (host.cn_on && (host.buttons ^ buttons) & 0b1110)
+        host.irq_flags |= 1 << HAL_IRQ_BUTTONS;
+    host.buttons = buttons;
+    host_run_interrupts();
+}
+
+void hal_init(void) {
+    Host_Registers reset = {0};
+    Spi_Sink sink = host.spi_sink;
+
+    host = reset;
+    host.spi_sink = sink;
+    host.pins = 0xFF;
+}
+
+void hal_pin_set(Hal_Pin pin, bool high) {
+    if (high)
+        host.pins |= 1 << pin;
+    else
+        host.pins &= ~(1 << pin);
+}
+
+unsigned char hal_buttons(void) {
+    return host.buttons;
+}
+
+void hal_buttons_init(void) {
+    host.cn_on = true;
+}
+
+uint8_t hal_spi_transfer(uint8_t data) {
+    spi_out(data);
+    return 0;
+}
+
+void hal_spi_drain(void) {
+}
+
+void hal_spi_send(const uint8_t *data, unsigned short size) {
+    host.tx_data = data;
+    host.tx_left = size;
+    tx_pump();
+    if (host.tx_irq)
+        host.irq_enabled |= 1 << HAL_IRQ_SPI;
+    host_run_interrupts();
+}
+
+bool hal_spi_sent(void) {
+    if (!host.tx_data)
+        return false;
+
+    tx_pump();
+    if (host.tx_left)
+        return false;
+
+    host.irq_enabled &= ~(1 << HAL_IRQ_SPI);
+    host.tx_data = 0;
+    host.tx_blocks++;
+    return true;
+}
+
+void hal_spi_use_interrupt(unsigned char priority) {
+    host.tx_irq = true;
+    if (host.tx_data)
+        host.irq_enabled |= 1 << HAL_IRQ_SPI;
+}
+
+void hal_timer_init(unsigned int hz) {
+    host.timer_hz = hz;
+    host.timer_ticks = 0;
+    host.irq_flags &= ~(1 << HAL_IRQ_TIMER);
+}
+
+bool hal_irq_pending(Hal_Irq irq) {
+    return host.irq_flags & 1 << irq;
+}
+
+void hal_irq_clear(Hal_Irq irq) {
+    host.irq_flags &= ~(1 << irq);
+}
+
+void hal_irq_enable(Hal_Irq irq, unsigned char priority) {
+    host.irq_enabled |= 1 << irq;
+}
+
+/* The interrupt functions from labwork.S */
+
+void enable_interrupt(void) {
+    host.interrupts_on = true;
+    host_run_interrupts();
+}
+
+void disable_interrupt(void) {
+    host.interrupts_on = false;
+}
+
+/**
+ * Nothing happens while the core sleeps except the timer, so unless
+ * something is already waiting the time moves on to the next period.
+ */
+void sleep_until_interrupt(void) {
+    if (!(host.irq_flags & host.irq_enabled) && host.timer_hz) {
+        host.timer_ticks++;
+        host.irq_flags |= 1 << HAL_IRQ_TIMER;
+    }
+    enable_interrupt();
+}
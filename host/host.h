@@ -0,0 +1,81 @@
+#ifndef HOST_H_6QW2ZK1D
+#define HOST_H_6QW2ZK1D
+
+/**
+ * @file    host.h
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * The simulated hardware the game runs on when it's built for a PC with
+ * "make host". host/hal.c implements the functions of hal.c (and the
+ * interrupt functions of labwork.S) on top of these registers.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include <stdbool.h>        /* To be able to use boolean */
+#include "../declaration.h" /* Declarations of project specific functions */
+
+// Called with every byte the display gets and the D/C line at the time
+typedef void (*Spi_Sink)(uint8_t data, bool is_data);
+
+// Bytes received by the virtual display
+typedef struct {
+    uint32_t commands;          // Command bytes, arguments included
+    uint32_t data;              // Data bytes
+    uint32_t redundant;         // Data bytes that wrote what was already there
+} Oled_Stats;
+
+// The simulated register file
+typedef struct {
+    // GPIO
+    unsigned char buttons;      // Held buttons, BTN1 in bit 0
+    unsigned char pins;         // Display pins, bit n is Hal_Pin n
+    bool cn_on;                 // Change notification on BTN2-4
+
+    // SPI2
+    uint32_t spi_bytes;         // Bytes sent
+    Spi_Sink spi_sink;          // Where the bytes go, 0 for nowhere
+
+    // The block being pumped out to SPI2 by hal_spi_sent()
+    bool tx_irq;                // The transmit interrupt is used
+    const uint8_t *tx_data;     // The next byte, 0 if there's no block
+    unsigned short tx_left;
+    uint32_t tx_blocks;         // Blocks sent
+
+    // Timer 2
+    unsigned int timer_hz;      // 0 while it's stopped
+    uint32_t timer_ticks;       // Periods since it was started
+
+    // Interrupts
+    unsigned char irq_flags;    // IFS, bit n is Hal_Irq n
+    unsigned char irq_enabled;  // IEC
+    bool interrupts_on;         // The core takes interrupts
+    bool in_isr;
+} Host_Registers;
+
+extern Host_Registers host;
+
+/* Declare the interrupt handler from interrupt.c */
+void user_isr(void);
+
+/* Declare functions from host/hal.c */
+void host_set_buttons(unsigned char buttons);
+void host_run_interrupts(void);
+
+/* Declare functions from host/oled.c */
+void oled_reset(void);
+void oled_receive(uint8_t byte, bool is_data);
+bool oled_pixel(int x, int y);
+uint8_t oled_read(int page, int column);
+uint32_t oled_checksum(void);
+Oled_Stats oled_frame(void);
+Oled_Stats oled_total(void);
+bool oled_write_pbm(const char *path);
+
+/* Declare functions from host/replay.c */
+bool replay_load(const char *path, uint64_t *seed, uint32_t *end);
+unsigned char replay_buttons(uint32_t tick);
+
+#endif /* end of include guard: HOST_H_6QW2ZK1D */
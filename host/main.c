@@ -0,0 +1,176 @@
+/**
+ * @file    main.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Runs the game on a PC against the simulated hardware in host/hal.c.
+ * Build it with "make host" and run it as
+ *
+ *     ./outfile-host [-t ticks] [-p prefix] [-w file | -r file] [-c]
+ *
+ * It plays for that many scheduler ticks (a minute by default) with a
+ * button pressed every now and then, so it goes through the menu, games,
+ * the game over animation and back. The display is the virtual SSD1306
+ * in host/oled.c, with -p every frame it shows is saved as
+ * prefix000000.pbm and so on. At the end it tells how fast the simulated
+ * time went and how many bytes the frames took, which makes it a handy
+ * thing to run under a profiler or to compare rendering changes with.
+ *
+ * With -w the first game played is saved as a recording (see record.c).
+ * With -r a recording is played instead of the presses: the game starts
+ * from the recorded seed on the recorded tick and gets the same buttons,
+ * and the run goes on until a little after its game over unless -t says
+ * otherwise. Every frame gets a checksum of the pixels on the panel, -c
+ * prints them with the tick they were shown on, and the checksum of them
+ * all is printed at the end. A replay gives the same frames every time,
+ * so a changed checksum means a change in what the game does or shows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "host.h"           /* The simulated registers */
+
+// How long a button is held and how long between each press, in ticks
+#define PRESS_TICKS MS_TO_TICKS(40)
+#define PRESS_EVERY MS_TO_TICKS(300)
+
+// The buttons pressed in turn, start (or rotate), right, left, drop
+static const unsigned char presses[] = { 8, 2, 4, 1, 1 };
+
+/**
+ * Saves the recording of the game that was played.
+ */
+static bool record_write(const char *path) {
+    uint8_t data[RECORD_SIZE_MAX];
+    unsigned int size = record_save(data, sizeof(data));
+    FILE *file = fopen(path, "wb");
+
+    if (!file)
+        return false;
+    if (fwrite(data, 1, size, file) != size) {
+        fclose(file);
+        return false;
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t ticks = 60 * SCHEDULER_HZ;
+    uint32_t press, frames = 0, largest = 0;
+    uint32_t frame_sum, checksum = 2166136261u, end;
+    uint64_t seed;
+    const char *prefix = 0, *record_path = 0, *replay_path = 0;
+    bool ticks_set = false, print_sums = false;
+    char path[256];
+    Oled_Stats stats, total;
+    clock_t start;
+    double seconds;
+    int option;
+
+    while((option = getopt(argc, argv, "t:p:w:r:c")) != -1)
+        switch(option) {
+            case 't':
+                ticks = strtoul(optarg, 0, 0);
+                ticks_set = true;
+                break;
+            case 'p':
+                prefix = optarg;
+                break;
+            case 'w':
+                record_path = optarg;
+                break;
+            case 'r':
+                replay_path = optarg;
+                break;
+            case 'c':
+                print_sums = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t ticks] [-p prefix] [-w file | -r file] [-c]\n",
+                        argv[0]);
+                return 1;
+        }
+
+    if (replay_path) {
+        if (!replay_load(replay_path, &seed, &end))
+            return 1;
+        // The game over animation and back to the menu
+        if (!ticks_set)
+            ticks = end + 3 * SCHEDULER_HZ;
+    }
+
+    host.spi_sink = oled_receive;
+    oled_reset();
+    hal_init();
+    init();
+    if (replay_path)
+        game_seed(seed);
+    // Start up isn't a frame
+    oled_frame();
+
+    start = clock();
+    while(host.timer_ticks < ticks) {
+        if (replay_path) {
+            // Held just before the next tick so they are read on it, the
+            // tick they were recorded on
+            host.buttons = replay_buttons(host.timer_ticks + 1);
+        } else {
+            press = host.timer_ticks / PRESS_EVERY;
+            host_set_buttons(host.timer_ticks % PRESS_EVERY < PRESS_TICKS ?
+                    presses[press % sizeof(presses)] : 0);
+        }
+        update();
+
+        if (record_path && record_done()) {
+            if (!record_write(record_path)) {
+                perror(record_path);
+                return 1;
+            }
+            record_path = 0;
+        }
+
+        // A frame is done when the display has got something and the
+        // transfer is over
+        if (render_busy())
+            continue;
+        stats = oled_frame();
+        if (!stats.commands && !stats.data)
+            continue;
+
+        if (stats.commands + stats.data > largest)
+            largest = stats.commands + stats.data;
+        frame_sum = oled_checksum();
+        checksum = (checksum ^ frame_sum) * 16777619u;
+        if (print_sums)
+            printf("%u %08x\n", host.timer_ticks, frame_sum);
+        if (prefix) {
+            snprintf(path, sizeof(path), "%s%06u.pbm", prefix, frames);
+            if (!oled_write_pbm(path)) {
+                perror(path);
+                return 1;
+            }
+        }
+        frames++;
+    }
+    seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    total = oled_total();
+
+    printf("%u ticks (%.1f s of game time) in %.3f s, %.0f ticks/s\n",
+            ticks, (double) ticks / SCHEDULER_HZ, seconds,
+            seconds > 0 ? ticks / seconds : 0);
+    printf("%u bytes to the display in %u blocks\n",
+            host.spi_bytes, host.tx_blocks);
+    printf("%u frames: %u command bytes, %u data bytes (%u redundant), "
+            "%.1f bytes a frame, %u at most\n",
+            frames, total.commands, total.data, total.redundant,
+            frames ? (double) (total.commands + total.data) / frames : 0,
+            largest);
+    printf("checksum %08x\n", checksum);
+    if (record_path)
+        fprintf(stderr, "%s: no game was played to the end\n", record_path);
+    return 0;
+}
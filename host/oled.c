@@ -0,0 +1,257 @@
+/**
+ * @file    oled.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * A virtual SSD1306 for the host build. It gets every byte sent on SPI2
+ * with the D/C line, runs the commands the same way the controller does
+ * (see the SSD1306 datasheet) and writes the data into its own display
+ * RAM. What the 128x32 panel shows can then be read a pixel at a time or
+ * saved as a PBM image, and every byte is counted so the cost of a frame
+ * can be measured exactly.
+ */
+
+#include <stdio.h>
+#include "host.h"           /* The simulated registers */
+
+// Addressing modes, the argument of command 0x20
+#define MODE_HORIZONTAL 0
+#define MODE_VERTICAL 1
+#define MODE_PAGE 2
+
+typedef struct {
+    uint8_t ram[8][128];        // Display RAM, a byte for 8 rows of a column
+    unsigned char mode;
+    unsigned char column, page; // Where the next data byte goes
+    unsigned char column_first, column_last;
+    unsigned char page_first, page_last;
+    bool segment_remap;         // Column 127 is shown on the left
+    bool com_reverse;           // Page 3 is shown at the top
+    bool on;
+
+    // The command being received and the arguments it's waiting for
+    uint8_t command;
+    uint8_t args[6];
+    unsigned char arg_count, args_left;
+} Oled;
+
+static Oled oled;
+static Oled_Stats frame;
+static Oled_Stats total;
+
+/**
+ * How many argument bytes follow a command.
+ */
+static unsigned char command_args(uint8_t command) {
+    switch(command) {
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x26: case 0x27:
+            return 6;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Runs a command once all of its arguments are there.
+ */
+static void command_run(void) {
+    uint8_t c = oled.command;
+
+    if (c < 0x10 && oled.mode == MODE_PAGE)
+        oled.column = (oled.column & 0xF0) | c;
+    else if (c < 0x20 && oled.mode == MODE_PAGE)
+        oled.column = (oled.column & 0x0F) | (c & 0x0F) << 4;
+    else if (c >= 0xB0 && c <= 0xB7 && oled.mode == MODE_PAGE)
+        oled.page = c & 7;
+    else switch(c) {
+        case 0x20:
+            oled.mode = oled.args[0] & 3;
+            break;
+        case 0x21:
+            oled.column_first = oled.column = oled.args[0] & 0x7F;
+            oled.column_last = oled.args[1] & 0x7F;
+            break;
+        case 0x22:
+            oled.page_first = oled.page = oled.args[0] & 7;
+            oled.page_last = oled.args[1] & 7;
+            break;
+        case 0xA0: case 0xA1:
+            oled.segment_remap = c & 1;
+            break;
+        case 0xC0: case 0xC8:
+            oled.com_reverse = c & 8;
+            break;
+        case 0xAE: case 0xAF:
+            oled.on = c & 1;
+            break;
+    }
+}
+
+/**
+ * Writes a data byte and moves the address on the way the addressing
+ * mode says.
+ */
+static void data_write(uint8_t data) {
+    if (oled.ram[oled.page][oled.column] == data) {
+        frame.redundant++;
+        total.redundant++;
+    }
+    oled.ram[oled.page][oled.column] = data;
+
+    switch(oled.mode) {
+        case MODE_HORIZONTAL:
+            if (oled.column++ < oled.column_last)
+                break;
+            oled.column = oled.column_first;
+            if (oled.page++ >= oled.page_last)
+                oled.page = oled.page_first;
+            break;
+        case MODE_VERTICAL:
+            if (oled.page++ < oled.page_last)
+                break;
+            oled.page = oled.page_first;
+            if (oled.column++ >= oled.column_last)
+                oled.column = oled.column_first;
+            break;
+        default:
+            oled.column = (oled.column + 1) & 0x7F;
+    }
+}
+
+/**
+ * Puts the controller in the state it has after a reset.
+ */
+void oled_reset(void) {
+    Oled reset = {0};
+    Oled_Stats none = {0};
+
+    oled = reset;
+    oled.mode = MODE_PAGE;
+    oled.column_last = 127;
+    oled.page_last = 7;
+    frame = none;
+    total = none;
+}
+
+/**
+ * Takes a byte from SPI2, use it as the Spi_Sink.
+ *
+ * @param [in] byte The byte
+ * @param [in] is_data The D/C line, true for data
+ */
+void oled_receive(uint8_t byte, bool is_data) {
+    if (is_data) {
+        frame.data++;
+        total.data++;
+        data_write(byte);
+        return;
+    }
+
+    frame.commands++;
+    total.commands++;
+    if (oled.args_left) {
+        oled.args[oled.arg_count++] = byte;
+        if (--oled.args_left == 0)
+            command_run();
+        return;
+    }
+
+    oled.command = byte;
+    oled.arg_count = 0;
+    oled.args_left = command_args(byte);
+    if (!oled.args_left)
+        command_run();
+}
+
+/**
+ * Is the pixel lit on the panel? (0, 0) is the top left corner as the
+ * panel is seen.
+ *
+ * @param [in] x 0-127 from the left
+ * @param [in] y 0-31 from the top
+ */
+bool oled_pixel(int x, int y) {
+    int column = oled.segment_remap ? 127 - x : x;
+    int row = oled.com_reverse ? 31 - y : y;
+
+    return oled.on && oled.ram[row / 8][column] >> (row % 8) & 1;
+}
+
+/**
+ * A byte of the display RAM, as it was written.
+ *
+ * @param [in] page 0-7
+ * @param [in] column 0-127
+ */
+uint8_t oled_read(int page, int column) {
+    return oled.ram[page][column];
+}
+
+/**
+ * A checksum (32 bit FNV-1a) of what the panel shows, the same for two
+ * frames only if every pixel is.
+ */
+uint32_t oled_checksum(void) {
+    uint32_t hash = 2166136261u;
+    int x, y;
+
+    for(y = 0; y < 32; y++)
+        for(x = 0; x < 128; x++)
+            hash = (hash ^ oled_pixel(x, y)) * 16777619u;
+    return hash;
+}
+
+/**
+ * The bytes received since the last call, which then starts a new frame.
+ */
+Oled_Stats oled_frame(void) {
+    Oled_Stats last = frame;
+    Oled_Stats none = {0};
+
+    frame = none;
+    return last;
+}
+
+/**
+ * The bytes received since the reset.
+ */
+Oled_Stats oled_total(void) {
+    return total;
+}
+
+/**
+ * Saves what the panel shows as a (binary) PBM image. The lit pixels
+ * are white and the rest black, like on the panel.
+ *
+ * @param [in] path The file to write
+ * @return false if it couldn't be written
+ */
+bool oled_write_pbm(const char *path) {
+    FILE *file = fopen(path, "wb");
+    uint8_t row[128 / 8];
+    int x, y;
+
+    if (!file)
+        return false;
+
+    fprintf(file, "P4\n128 32\n");
+    for(y = 0; y < 32; y++) {
+        // A PBM row is 8 pixels a byte, left one first, 1 is black
+        for(x = 0; x < 128; x++)
+            if (oled_pixel(x, y))
+                row[x / 8] &= ~(0x80 >> x % 8);
+            else
+                row[x / 8] |= 0x80 >> x % 8;
+        fwrite(row, 1, sizeof(row), file);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file    replay.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Reads a game recorded by record.c and gives back its buttons a tick at
+ * a time, for host/main.c to hold down.
+ */
+
+#include <stdio.h>
+#include "host.h"           /* The simulated registers */
+
+static uint16_t runs[RECORD_RUNS];
+static unsigned short count;
+static uint32_t start;
+
+// The run replay_buttons() is at and the tick it ends on
+static unsigned short run;
+static uint32_t runEnd;
+
+static uint32_t read_le(const uint8_t *bytes, int size) {
+    uint32_t value = 0;
+
+    while(size--)
+        value = value << 8 | bytes[size];
+    return value;
+}
+
+/**
+ * Reads a recording.
+ *
+ * @param [in] path The file
+ * @param [out] seed The seed of the game
+ * @param [out] end The tick the game ended on
+ * @return false, with a message, if it isn't a recording that can be
+ *         replayed
+ */
+bool replay_load(const char *path, uint64_t *seed, uint32_t *end) {
+    uint8_t data[RECORD_SIZE_MAX];
+    FILE *file = fopen(path, "rb");
+    size_t size;
+    unsigned short i;
+
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    if (size < RECORD_HEADER || data[0] != 'T' || data[1] != 'R' ||
+            data[2] != 'C' || data[3] != '1') {
+        fprintf(stderr, "%s: not a recording\n", path);
+        return false;
+    }
+    count = read_le(data + 6, 2);
+    if (count > RECORD_RUNS || size != RECORD_HEADER + 2u * count) {
+        fprintf(stderr, "%s: the recording is cut short\n", path);
+        return false;
+    }
+    if (data[4] & 1) {
+        fprintf(stderr, "%s: the start of the game was lost\n", path);
+        return false;
+    }
+
+    *seed = read_le(data + 8, 4) | (uint64_t) read_le(data + 12, 4) << 32;
+    start = read_le(data + 16, 4);
+    *end = start + read_le(data + 20, 4);
+    for(i = 0; i < count; i++)
+        runs[i] = read_le(data + RECORD_HEADER + 2 * i, 2);
+
+    run = 0;
+    runEnd = start + (count ? (runs[0] & 0x0FFF) + 1 : 0);
+    return true;
+}
+
+/**
+ * The buttons held on a tick, none before and after the game. The ticks
+ * must be asked for in order.
+ */
+unsigned char replay_buttons(uint32_t tick) {
+    if (tick < start)
+        return 0;
+
+    while(run < count && tick >= runEnd)
+        if (++run < count)
+            runEnd += (runs[run] & 0x0FFF) + 1;
+
+    return run < count ? runs[run] >> 12 : 0;
+}
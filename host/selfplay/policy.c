@@ -0,0 +1,144 @@
+/**
+ * @file    policy.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * The policies of the self-play tool. "random" mashes the buttons, "idle"
+ * lets every shape fall and "bot" plays properly: for every new shape it
+ * tries each rotation and column on a copy of the game, picks the one
+ * that leaves the best grid and then presses its way there and hard
+ * drops.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include "selfplay.h"
+
+// The bit of column x in a grid row, see tetrishelper.c
+#define GRID_CELL(x) (1 << ((x) + 1))
+
+/**
+ * How good a grid is, higher is better. The weights are the ones of
+ * the El-Tetris bot times 100.
+ *
+ * @param [in] state The game after the shape was locked
+ * @param [in] rows The rows that locking it removed
+ */
+static int evaluate(const Game_State *state, int rows) {
+    int x, y, height = 0, holes = 0, bumps = 0;
+
+    for(x = 0; x < 10; x++) {
+        height += state->skyline[x];
+        for(y = 0; y < state->skyline[x]; y++)
+            if (!(state->grid[y + 1] & GRID_CELL(x)))
+                holes++;
+        if (x)
+            bumps += abs(state->skyline[x] - state->skyline[x - 1]);
+    }
+    return 76 * rows - 51 * height - 36 * holes - 18 * bumps;
+}
+
+/**
+ * Finds where the shape should go. It's turned where it is and then
+ * moved a column at a time, so only places the buttons can reach are
+ * tried.
+ */
+static void bot_plan(Player *player, const Game_State *state) {
+    Game_State trial;
+    Shape turned, moved;
+    Row_Range locked;
+    unsigned char cleared[MAX_CLEARED_ROWS];
+    int r, dx, way, i, distance, rows, value, best = INT_MIN;
+
+    turned = state->shape;
+    player->rotation = turned.rotation;
+    player->x = turned.piece[0].x;
+    for(r = 0; r < 4; r++) {
+        if (r && !rotate_shape(state, &turned))
+            break;
+
+        for(dx = -9; dx <= 9; dx++) {
+            moved = turned;
+            way = dx < 0 ? -1 : 1;
+            for(i = 0; i != dx; i += way) {
+                if (collides(state, &moved, way, 0, 0))
+                    break;
+                moveSideways(&moved, way);
+            }
+            if (i != dx)
+                continue;
+
+            trial = *state;
+            distance = drop_distance(&trial, &moved);
+            for(i = 0; i < 4; i++)
+                moved.piece[i].y -= distance;
+            lock_shape(&trial, &moved, &locked);
+            rows = fullRow(&trial, &locked, cleared);
+
+            value = evaluate(&trial, rows);
+            if (value > best) {
+                best = value;
+                player->rotation = moved.rotation;
+                player->x = moved.piece[0].x;
+            }
+        }
+    }
+    player->planned = true;
+    player->pieces = state->pieces;
+}
+
+/**
+ * Presses one button a step until the shape is turned and moved to the
+ * plan, then soft drop every step, which is a hard drop from the second
+ * press. A move that is blocked is tried again until the shape locks.
+ */
+static void bot_act(Player *player, const Game_State *state, Game_Input *input) {
+    unsigned char i;
+
+    if (!player->planned || player->pieces != state->pieces)
+        bot_plan(player, state);
+
+    // BTN4 turns, BTN2 goes right, BTN3 left and BTN1 drops
+    if (state->shape.rotation != player->rotation)
+        i = 3;
+    else if (state->shape.piece[0].x < player->x)
+        i = 1;
+    else if (state->shape.piece[0].x > player->x)
+        i = 2;
+    else
+        i = 0;
+
+    input->pressed = 1 << i;
+    input->pressed_at[i] = input->time;
+}
+
+/**
+ * Presses a random button every fourth step or so and now and then
+ * holds a few down.
+ */
+static void random_act(Player *player, const Game_State *state, Game_Input *input) {
+    uint32_t r = pcg32_random_r(&player->rng);
+    unsigned char i = r >> 2 & 3;
+
+    if ((r & 3) == 0) {
+        input->pressed = 1 << i;
+        input->pressed_at[i] = input->time - (r >> 8) % LOGIC_PERIOD;
+    }
+    if ((r >> 4 & 7) == 0)
+        input->held = r >> 16 & 7;
+}
+
+/**
+ * Never touches a button.
+ */
+static void idle_act(Player *player, const Game_State *state, Game_Input *input) {
+}
+
+const Policy_Entry policies[] = {
+    { "bot", bot_act },
+    { "random", random_act },
+    { "idle", idle_act },
+    { 0, 0 }
+};
@@ -0,0 +1,252 @@
+/**
+ * @file    selfplay.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Plays many games at once on a PC, as fast as it can, to measure the
+ * game logic. Build it with "make selfplay" and run it as
+ *
+ *     ./outfile-selfplay [-n games] [-j threads] [-s seed] [-l pieces] [-p policy]
+ *
+ * Game number i is started from seed + i, and as game_start() makes the
+ * pcg32 stream (inc) from the seed every game gets pieces of its own.
+ * The games are handed out to a pool of threads, one per core by default.
+ * Each game is only touched by the thread playing it so they share
+ * nothing and a game plays the same on any number of threads. The
+ * checksum at the end shows that: it is made from how every game ended
+ * and must not change with -j, only with the rules.
+ *
+ * A game is stepped every LOGIC_PERIOD ticks like on the board, with the
+ * buttons a policy (see policy.c) chooses. It ends at game over or when
+ * -l pieces have been locked, as the bot can play for a very long time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "selfplay.h"
+
+// What the games played by one thread added up to
+typedef struct {
+    uint32_t games;
+    uint64_t ticks;             // Game time played
+    uint64_t steps;
+    uint64_t pieces[7];         // Locked pieces of every Piece_Type
+    uint64_t rows;
+    unsigned int rows_max;      // The most rows in one game
+    uint64_t score;
+    uint64_t step_ns;           // Time spent in game_step()
+    uint64_t step_ns_max;
+    uint64_t checksum;
+} Stats;
+
+static uint32_t games = 1000;
+static uint64_t firstSeed = 1;
+static unsigned int maxPieces = 1000;
+static Policy policy;
+
+// The next game to hand out
+static uint32_t nextGame;
+
+static const char pieceNames[7] = { 'I', 'L', 'J', 'O', 'T', 'Z', 'S' };
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static uint32_t bcd_to_binary(uint32_t bcd) {
+    uint32_t num = 0;
+    int digit;
+
+    for(digit = 28; digit >= 0; digit -= 4)
+        num = num * 10 + (bcd >> digit & 0xF);
+    return num;
+}
+
+/**
+ * Mixes a number into a checksum (the finalizer of splitmix64).
+ */
+static uint64_t mix(uint64_t hash, uint64_t value) {
+    hash ^= value;
+    hash = (hash ^ hash >> 30) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ hash >> 27) * 0x94D049BB133111EBull;
+    return hash ^ hash >> 31;
+}
+
+/**
+ * Plays a game to the end and adds it to the stats.
+ *
+ * @param [in] game The number of the game
+ * @param [in,out] stats The stats of the thread playing it
+ */
+static void play(uint32_t game, Stats *stats) {
+    uint64_t seed = firstSeed + game;
+    Game_State state;
+    Game_Input input;
+    Player player;
+    unsigned int pieces;
+    Piece_Type type;
+    uint64_t start, ns;
+
+    game_start(&state, seed, 0);
+    memset(&player, 0, sizeof(player));
+    player.rng.state = seed * 0x9E3779B97F4A7C15ull;
+    player.rng.inc = seed << 1 | 1;
+
+    while(!state.over && state.pieces < maxPieces) {
+        memset(&input, 0, sizeof(input));
+        input.time = state.time + LOGIC_PERIOD;
+        policy(&player, &state, &input);
+
+        pieces = state.pieces;
+        type = state.shape.piece_type;
+        start = now_ns();
+        game_step(&state, &input);
+        ns = now_ns() - start;
+
+        stats->steps++;
+        stats->step_ns += ns;
+        if (ns > stats->step_ns_max)
+            stats->step_ns_max = ns;
+        // A step locks one shape at most
+        if (state.pieces != pieces)
+            stats->pieces[type]++;
+    }
+
+    stats->games++;
+    stats->ticks += state.time;
+    stats->rows += state.rows;
+    if (state.rows > stats->rows_max)
+        stats->rows_max = state.rows;
+    stats->score += bcd_to_binary(state.score);
+    // Added up so it doesn't matter which thread played which game
+    stats->checksum += mix(mix(mix(seed, state.score), state.pieces), state.time);
+}
+
+/**
+ * Plays games until there are none left. The stats are added up on the
+ * stack and only copied out at the end, the entries of the threads are
+ * next to each other and writing them all the time would have the cores
+ * fight over the cache lines.
+ */
+static void *worker(void *arg) {
+    Stats stats;
+    uint32_t game;
+
+    memset(&stats, 0, sizeof(stats));
+    while((game = __sync_fetch_and_add(&nextGame, 1)) < games)
+        play(game, &stats);
+    *(Stats *) arg = stats;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *name = policies[0].name;
+    pthread_t *pool;
+    Stats *stats, total;
+    uint64_t start, pieces = 0;
+    double seconds;
+    int option, i, p;
+
+    while((option = getopt(argc, argv, "n:j:s:l:p:")) != -1)
+        switch(option) {
+            case 'n':
+                games = strtoul(optarg, 0, 0);
+                break;
+            case 'j':
+                threads = strtol(optarg, 0, 0);
+                break;
+            case 's':
+                firstSeed = strtoull(optarg, 0, 0);
+                break;
+            case 'l':
+                maxPieces = strtoul(optarg, 0, 0);
+                break;
+            case 'p':
+                name = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n games] [-j threads] [-s seed] "
+                        "[-l pieces] [-p policy]\n", argv[0]);
+                return 1;
+        }
+
+    for(p = 0; policies[p].name; p++)
+        if (!strcmp(policies[p].name, name))
+            policy = policies[p].act;
+    if (!policy) {
+        fprintf(stderr, "%s: no policy %s, there is", argv[0], name);
+        for(p = 0; policies[p].name; p++)
+            fprintf(stderr, " %s", policies[p].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    if (threads < 1)
+        threads = 1;
+
+    pool = malloc(threads * sizeof(*pool));
+    stats = calloc(threads, sizeof(*stats));
+    if (!pool || !stats) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    start = now_ns();
+    for(i = 0; i < threads; i++)
+        if (pthread_create(&pool[i], 0, worker, &stats[i])) {
+            perror("pthread_create");
+            return 1;
+        }
+    for(i = 0; i < threads; i++)
+        pthread_join(pool[i], 0);
+    seconds = (now_ns() - start) / 1e9;
+
+    memset(&total, 0, sizeof(total));
+    for(i = 0; i < threads; i++) {
+        total.games += stats[i].games;
+        total.ticks += stats[i].ticks;
+        total.steps += stats[i].steps;
+        for(p = 0; p < 7; p++)
+            total.pieces[p] += stats[i].pieces[p];
+        total.rows += stats[i].rows;
+        if (stats[i].rows_max > total.rows_max)
+            total.rows_max = stats[i].rows_max;
+        total.score += stats[i].score;
+        total.step_ns += stats[i].step_ns;
+        if (stats[i].step_ns_max > total.step_ns_max)
+            total.step_ns_max = stats[i].step_ns_max;
+        total.checksum += stats[i].checksum;
+    }
+    for(p = 0; p < 7; p++)
+        pieces += total.pieces[p];
+
+    printf("%u games with the %s policy on %ld threads in %.3f s\n",
+            total.games, name, threads, seconds);
+    printf("%.1f games/s, %.0f ticks/s (%.0f s of game time a second), %.0f steps/s\n",
+            total.games / seconds, total.ticks / seconds,
+            total.ticks / seconds / SCHEDULER_HZ, total.steps / seconds);
+    printf("%llu pieces:", (unsigned long long) pieces);
+    for(p = 0; p < 7; p++)
+        printf(" %c %.1f%%", pieceNames[p], pieces ? 100.0 * total.pieces[p] / pieces : 0);
+    printf("\n");
+    printf("%.1f rows a game, %u at most, %.0f points a game\n",
+            total.games ? (double) total.rows / total.games : 0, total.rows_max,
+            total.games ? (double) total.score / total.games : 0);
+    printf("game_step %.0f ns on average, %llu ns at most\n",
+            total.steps ? (double) total.step_ns / total.steps : 0,
+            (unsigned long long) total.step_ns_max);
+    printf("checksum %016llx\n", (unsigned long long) total.checksum);
+
+    free(pool);
+    free(stats);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef SELFPLAY_H_3KD8W0QX
+#define SELFPLAY_H_3KD8W0QX
+
+/**
+ * @file    selfplay.h
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * The players the self-play tool can put in front of a game. A policy
+ * looks at the game before every step and decides which buttons are
+ * pressed and held during it, the same way the buttons would reach
+ * game_step() on the board.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include <stdbool.h>        /* To be able to use boolean */
+#include "../../declaration.h" /* Declarations of project specific functions */
+
+// What a player remembers between the steps of one game
+typedef struct {
+    pcg32_random_t rng;         // For the policies that play at random
+    bool planned;               // There is a plan for the shape
+    unsigned int pieces;        // The pieces locked when the plan was made
+    unsigned char rotation;     // Where the plan wants the shape
+    unsigned char x;
+} Player;
+
+// Fills in the buttons of the step to input->time
+typedef void (*Policy)(Player *player, const Game_State *state, Game_Input *input);
+
+typedef struct {
+    const char *name;
+    Policy act;
+} Policy_Entry;
+
+/* Declare the policies from host/selfplay/policy.c, ended by a 0 name */
+extern const Policy_Entry policies[];
+
+#endif /* end of include guard: SELFPLAY_H_3KD8W0QX */
@@ -0,0 +1,42 @@
+#ifndef CHECK_H_8TR4VN2E
+#define CHECK_H_8TR4VN2E
+
+/**
+ * @file    check.h
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * What the tests in host/tests/ are written with. Every file there is a
+ * program of its own, "make check" builds them against the host build
+ * and runs them. A test goes on after a check fails so all of the
+ * failures are shown, and check_done() is what main() returns.
+ */
+
+#include <stdio.h>
+
+static unsigned int checks, checkFailures;
+
+#define CHECK(cond) check_that((cond), #cond, __FILE__, __LINE__)
+
+static inline void check_that(int ok, const char *cond, const char *file, int line) {
+    checks++;
+    if (ok)
+        return;
+    checkFailures++;
+    fprintf(stderr, "%s:%d: failed: %s\n", file, line, cond);
+}
+
+/**
+ * Prints how it went.
+ *
+ * @param [in] name The name of the test
+ * @return The exit status, 0 if every check passed
+ */
+static inline int check_done(const char *name) {
+    printf("%s: %u checks, %u failed\n", name, checks, checkFailures);
+    return checkFailures != 0;
+}
+
+#endif /* end of include guard: CHECK_H_8TR4VN2E */
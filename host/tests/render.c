@@ -0,0 +1,259 @@
+/**
+ * @file    render.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Tests frame_present() and render_poll() against the virtual display.
+ * Rows are drawn with draw_row() and into a model of the screen at the
+ * same time, and after every frame the display RAM must be the model.
+ * The bytes a frame takes are worked out from the model as well, one
+ * window around the changes or one per page, so the choice of windows
+ * is checked too.
+ */
+
+#include <string.h>
+#include "../host.h"        /* The simulated registers */
+#include "check.h"
+
+// What the screen should show after the frame, and what it showed before
+static uint8_t model[4][128];
+static uint8_t shown[4][128];
+
+/**
+ * Draws a row into the back buffer and the model.
+ */
+static void put_row(unsigned char y, unsigned short mask) {
+    uint32_t column = rowFont[mask & 0x1F] | rowFont[32 + (mask >> 5 & 0x1F)];
+    int page, k;
+
+    draw_row(y, mask);
+    for(page = 0; page < 4; page++)
+        for(k = 0; k < 3; k++)
+            model[page][127 - y*3 - 1 - k] |= column >> page*8;
+}
+
+static void begin(void) {
+    frame_begin(LAYER_BLANK);
+    memset(model, 0, sizeof(model));
+}
+
+/**
+ * The bytes a frame should take, with the 6 bytes of command that set
+ * a window.
+ */
+static unsigned int frame_bytes(bool full) {
+    int page, first, last, windows = 0;
+    int all_first = 127, all_last = 0, page_first = 3, page_last = 0;
+    unsigned int separate = 0;
+
+    if (full)
+        return 6 + 512;
+
+    for(page = 0; page < 4; page++) {
+        for(first = 0; first < 128 && model[page][first] == shown[page][first]; first++)
+            ;
+        if (first == 128)
+            continue;
+        for(last = 127; model[page][last] == shown[page][last]; last--)
+            ;
+
+        windows++;
+        separate += 6 + last - first + 1;
+        if (first < all_first)
+            all_first = first;
+        if (last > all_last)
+            all_last = last;
+        if (page < page_first)
+            page_first = page;
+        page_last = page;
+    }
+
+    if (windows > 1 && 6 + (all_last - all_first + 1) * (page_last - page_first + 1) <= separate)
+        return 6 + (all_last - all_first + 1) * (page_last - page_first + 1);
+    return separate;
+}
+
+static bool screen_is_model(void) {
+    int page, column;
+
+    for(page = 0; page < 4; page++)
+        for(column = 0; column < 128; column++)
+            if (oled_read(page, column) != model[page][column])
+                return false;
+    return true;
+}
+
+/**
+ * Puts the frame on the screen by polling and checks it.
+ *
+ * @return The bytes the frame took
+ */
+static Oled_Stats present(bool full) {
+    unsigned int bytes = frame_bytes(full);
+    Oled_Stats stats;
+
+    frame_present();
+    while(render_busy())
+        render_poll();
+
+    stats = oled_frame();
+    CHECK(stats.commands + stats.data == bytes);
+    CHECK(stats.commands % 6 == 0);
+    CHECK(screen_is_model());
+    memcpy(shown, model, sizeof(model));
+    return stats;
+}
+
+/**
+ * Frames that take one window, several or none.
+ */
+static void test_windows(void) {
+    Oled_Stats stats;
+    Square square;
+
+    // The first frame is all of the screen in one go
+    begin();
+    put_row(0, 0x3FF);
+    put_row(41, 0x201);
+    stats = present(true);
+    CHECK(stats.commands == 6 && stats.data == 512);
+
+    // Nothing changed, nothing is sent
+    begin();
+    put_row(0, 0x3FF);
+    put_row(41, 0x201);
+    stats = present(false);
+    CHECK(stats.commands == 0 && stats.data == 0);
+    CHECK(!render_busy());
+
+    // A square is its 3 columns on the pages it's on
+    begin();
+    put_row(0, 0x3FF);
+    put_row(41, 0x201);
+    put_row(20, 1 << 4);
+    square.x = 4;
+    square.y = 20;
+    draw_square(&square);
+    stats = present(false);
+    CHECK(stats.commands == 6 && stats.data <= 3 * 2);
+
+    // Squares far apart on different pages are a window each
+    begin();
+    put_row(0, 0x3FF);
+    put_row(41, 0x201);
+    put_row(2, 1 << 0);
+    put_row(39, 1 << 9);
+    stats = present(false);
+    CHECK(stats.commands > 6 && stats.data < 3 * 4);
+
+    // A whole row is 3 columns on every page, one window
+    begin();
+    put_row(0, 0x3FF);
+    put_row(41, 0x201);
+    put_row(2, 1 << 0);
+    put_row(39, 1 << 9);
+    put_row(30, 0x3FF);
+    stats = present(false);
+    CHECK(stats.commands == 6 && stats.data == 3 * 4);
+
+    // After display_update() the screen can't be trusted and all of it
+    // is sent again
+    display_update();
+    oled_frame();
+    memset(shown, 0, sizeof(shown));
+    begin();
+    put_row(5, 0x155);
+    stats = present(true);
+    CHECK(stats.data == 512);
+}
+
+/**
+ * The transfer is a byte a render_poll(), and the first byte of the
+ * next page when one is done. render_busy() holds until the last one is
+ * sent.
+ */
+static void test_busy(void) {
+    uint32_t polls = 0, blocks = host.tx_blocks;
+    Oled_Stats stats;
+
+    begin();
+    put_row(10, 0x3FF);
+    put_row(11, 0x0F0);
+    frame_present();
+    CHECK(render_busy());
+    // Only the first byte is on its way
+    CHECK(oled_frame().data == 1);
+
+    while(render_busy()) {
+        render_poll();
+        polls++;
+    }
+    stats = oled_frame();
+    blocks = host.tx_blocks - blocks;
+    CHECK(blocks > 1);
+    CHECK(polls == stats.data - (blocks - 1));
+    CHECK(screen_is_model());
+    memcpy(shown, model, sizeof(model));
+
+    // Polling when there's nothing to send does nothing
+    render_poll();
+    stats = oled_frame();
+    CHECK(stats.commands == 0 && stats.data == 0);
+}
+
+/**
+ * Random frames, each one checked against the model.
+ */
+static void test_random(pcg32_random_t *rng, int frames) {
+    uint32_t r;
+    int i, rows;
+
+    while(frames--) {
+        begin();
+        r = pcg32_random_r(rng);
+        rows = r & 7;
+        for(i = 0; i < rows; i++) {
+            r = pcg32_random_r(rng);
+            put_row(r % 42, r >> 8 & 0x3FF);
+        }
+        present(false);
+    }
+}
+
+/**
+ * With the SPI2 interrupt the whole frame is sent before
+ * frame_present() gets back, as the host has no time between bytes.
+ */
+static void test_interrupt(pcg32_random_t *rng) {
+    render_use_interrupt();
+    enable_interrupt();
+
+    begin();
+    put_row(7, 0x2AA);
+    put_row(33, 0x155);
+    frame_present();
+    CHECK(!render_busy());
+    CHECK(oled_frame().data > 0);
+    CHECK(screen_is_model());
+    memcpy(shown, model, sizeof(model));
+
+    test_random(rng, 500);
+}
+
+int main(void) {
+    pcg32_random_t rng = { 0x853C49E6748FEA9Bull, 0xDA3E39CB94B95BDBull };
+
+    host.spi_sink = oled_receive;
+    oled_reset();
+    hal_init();
+    display_init();
+    oled_frame();
+
+    test_windows();
+    test_busy();
+    test_random(&rng, 500);
+    test_interrupt(&rng);
+    return check_done("render");
+}
@@ -0,0 +1,156 @@
+/**
+ * @file    scheduler.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Tests the scheduler driven by the simulated timer, a tick every time
+ * the core sleeps. The tasks log where and when they were run.
+ */
+
+#include <string.h>
+#include "../host.h"        /* The simulated registers */
+#include "check.h"
+
+// The runs of the main loop tasks in the order they happened, '1' for
+// every_tick() and '3' for every_third()
+static char runLog[512];
+static unsigned int logged;
+
+static unsigned int isrRuns, isrOutside;
+static unsigned int tickRuns, thirdRuns, deferredInside, thirdLate;
+
+static void every_other(void) {
+    isrRuns++;
+    if (!host.in_isr)
+        isrOutside++;
+}
+
+static void every_tick(void) {
+    tickRuns++;
+    if (host.in_isr)
+        deferredInside++;
+    if (logged < sizeof(runLog) - 1)
+        runLog[logged++] = '1';
+}
+
+static void every_third(void) {
+    thirdRuns++;
+    if (host.in_isr)
+        deferredInside++;
+    if (scheduler_ticks() % 3)
+        thirdLate++;
+    if (logged < sizeof(runLog) - 1)
+        runLog[logged++] = '3';
+}
+
+static void never(void) {
+}
+
+static void log_clear(void) {
+    memset(runLog, 0, sizeof(runLog));
+    logged = 0;
+    isrRuns = tickRuns = thirdRuns = 0;
+}
+
+/**
+ * Lets the timer go off a number of times without running the main
+ * loop tasks.
+ */
+static void ticks(unsigned int count) {
+    while(count--)
+        sleep_until_interrupt();
+}
+
+static void test_add(void) {
+    CHECK(!scheduler_add(never, 0, false));
+    CHECK(scheduler_add(every_third, 3, false));
+    CHECK(scheduler_add(every_tick, 1, false));
+    CHECK(scheduler_add(every_other, 2, true));
+    CHECK(scheduler_add(never, 1000, true));
+    // All 4 are taken
+    CHECK(!scheduler_add(never, 1, false));
+}
+
+/**
+ * Tasks are run once a period, the main loop ones only from
+ * scheduler_run() and the others in the interrupt.
+ */
+static void test_period(void) {
+    uint32_t start = scheduler_ticks();
+    int i;
+
+    log_clear();
+    for(i = 0; i < 30; i++) {
+        ticks(1);
+        CHECK(scheduler_run());
+        CHECK(!scheduler_run());
+    }
+    CHECK(scheduler_ticks() - start == 30);
+    CHECK(tickRuns == 30);
+    CHECK(thirdRuns == 10);
+    CHECK(thirdLate == 0);
+    CHECK(isrRuns == 15);
+    CHECK(isrOutside == 0);
+    CHECK(deferredInside == 0);
+
+    // A tick runs the interrupt task but leaves the others for later
+    log_clear();
+    ticks(2);
+    CHECK(isrRuns == 1);
+    CHECK(tickRuns == 0);
+    CHECK(scheduler_run());
+    CHECK(tickRuns == 2);
+}
+
+/**
+ * A main loop task that fell behind is run once for every period it
+ * missed, in the order the tasks were added.
+ */
+static void test_catch_up(void) {
+    // Start on a multiple of 3
+    ticks(1);
+    scheduler_run();
+
+    log_clear();
+    ticks(6);
+    CHECK(isrRuns == 3);
+    CHECK(scheduler_run());
+    CHECK(!strcmp(runLog, "33111111"));
+    CHECK(thirdLate == 0);
+}
+
+/**
+ * A task more than 255 runs behind isn't run 256 times fewer, it
+ * keeps the 255 runs the count has room for.
+ */
+static void test_due_wrap(void) {
+    log_clear();
+    ticks(300);
+    CHECK(scheduler_run());
+    CHECK(tickRuns == 255);
+    CHECK(thirdRuns == 100);
+    CHECK(isrRuns == 150);
+
+    // And goes on as before
+    log_clear();
+    ticks(3);
+    CHECK(scheduler_run());
+    CHECK(tickRuns == 3);
+    CHECK(thirdRuns == 1);
+}
+
+int main(void) {
+    hal_init();
+    hal_timer_init(SCHEDULER_HZ);
+    hal_irq_enable(HAL_IRQ_TIMER, 4);
+    enable_interrupt();
+
+    test_add();
+    test_period();
+    test_catch_up();
+    test_due_wrap();
+    CHECK(deferredInside == 0);
+    return check_done("scheduler");
+}
@@ -0,0 +1,111 @@
+/**
+ * @file    input.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Button input. BTN2-4 (RD5-7) raise a change notification interrupt
+ * when they're pressed or released, BTN1 (RF1) has no change
+ * notification so it's sampled every INPUT_PERIOD scheduler ticks. Each
+ * change is debounced and put in a queue of press and release events
+ * with the tick it happened on, which the game reads from the main
+ * loop.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "declaration.h"    /* Declarations of project specific functions */
+
+// Must be a power of 2
+#define INPUT_QUEUE_SIZE 16
+// Changes of a button within this many ticks (20 ms) of the last one are bounces
+#define DEBOUNCE_TICKS (SCHEDULER_HZ / 50)
+
+// Written by the interrupts, read by the main loop
+static volatile Input_Event queue[INPUT_QUEUE_SIZE];
+static volatile unsigned char head = 0;
+static volatile unsigned char tail = 0;
+
+// The debounced state of the buttons
+static volatile unsigned char stable = 0;
+// When each button last changed
+static uint32_t last_change[4];
+
+/**
+ * Puts an event in the queue. It's dropped if the queue is full.
+ *
+ * @param [in] button The button that changed
+ * @param [in] pressed true if it was pressed, false if released
+ * @param [in] time The tick it changed on
+ */
+static void input_push(unsigned char button, bool pressed, uint32_t time) {
+    unsigned char next = (head + 1) & (INPUT_QUEUE_SIZE - 1);
+    if (next == tail)
+        return;
+
+    queue[head].time = time;
+    queue[head].button = button;
+    queue[head].pressed = pressed;
+    head = next;
+}
+
+/**
+ * Reads the buttons and queues the ones that changed. The first change
+ * of a button is taken right away and the changes within DEBOUNCE_TICKS
+ * after it are ignored. Since this also runs every INPUT_PERIOD, a
+ * button that ends up in another state after the bouncing is picked up
+ * then.
+ * Called from the change notification and the timer interrupt.
+ */
+void input_sample(void) {
+    unsigned char changed = hal_buttons() ^ stable;
+    uint32_t now = scheduler_ticks();
+    unsigned char i;
+
+    for(i = 0; i < 4; i++) {
+        if (!(changed & 1 << i) || now - last_change[i] < DEBOUNCE_TICKS)
+            continue;
+
+        last_change[i] = now;
+        stable ^= 1 << i;
+        input_push(1 << i, stable & 1 << i, now);
+    }
+}
+
+/**
+ * Takes the oldest event out of the queue if it happened before a tick.
+ * The events of that tick and later are left for the next call, so what
+ * is taken doesn't depend on how late the caller runs.
+ *
+ * @param [out] event Where the event is put
+ * @param [in] before The tick the event must have happened before
+ * @return false if there was no such event
+ */
+bool input_pop(Input_Event *event, uint32_t before) {
+    if (tail == head || (int32_t) (queue[tail].time - before) >= 0)
+        return false;
+
+    event->time = queue[tail].time;
+    event->button = queue[tail].button;
+    event->pressed = queue[tail].pressed;
+    tail = (tail + 1) & (INPUT_QUEUE_SIZE - 1);
+    return true;
+}
+
+/**
+ * The buttons that are held down right now, after debouncing.
+ */
+unsigned char input_state(void) {
+    return stable;
+}
+
+/**
+ * Hardware button init
+ */
+void input_init(void) {
+    hal_buttons_init();
+    hal_irq_clear(HAL_IRQ_BUTTONS);
+    hal_irq_enable(HAL_IRQ_BUTTONS, 4);     // Same priority as the timer
+
+    scheduler_add(input_sample, INPUT_PERIOD, true);
+}
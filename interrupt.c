@@ -9,8 +9,29 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"   /* Declarations of project specific functions */
 
+/**
+ * Called for every interrupt, checks the flags to see which one it was.
+ */
 void user_isr(void) {
+    // Timer 2, one scheduler tick
+    if (hal_irq_pending(HAL_IRQ_TIMER)) {
+        hal_irq_clear(HAL_IRQ_TIMER);
+        scheduler_tick();
+    }
+
+    // SPI2 can take the next byte of the frame
+    if (hal_irq_pending(HAL_IRQ_SPI)) {
+        // Cleared first, the byte render_poll() gives SPI2 may be sent
+        // before we get back here and its flag must not be lost
+        hal_irq_clear(HAL_IRQ_SPI);
+        render_poll();
+    }
+
+    // Change notification, one of BTN2-4 changed
+    if (hal_irq_pending(HAL_IRQ_BUTTONS)) {
+        input_sample();     // Reads PORTD, which ends the mismatch
+        hal_irq_clear(HAL_IRQ_BUTTONS);
+    }
 }
@@ -13,44 +13,10 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"    /* Declarations of project specific functions */
 
 int main(void) {
-    /* Set up peripheral bus clock */
-    /* OSCCONbits.PBDIV = 1; */
-    OSCCONCLR = 0x100000; /* clear PBDIV bit 1 */
-    OSCCONSET = 0x080000; /* set PBDIV bit 0 */
-
-    /* Set up output pins */
-    AD1PCFG = 0xFFFF;
-    ODCE = 0x0;
-    TRISECLR = 0xFF;
-    PORTE = 0x0;
-
-    /* Output pins for display signals */
-    PORTF = 0xFFFF;
-    PORTG = (1 << 9);
-    ODCF = 0x0;
-    ODCG = 0x0;
-    TRISFCLR = 0x70;
-    TRISGCLR = 0x200;
-
-    /* Set up input pins */
-    TRISDSET = (1 << 8);
-    TRISFSET = (1 << 1);
-
-    /* Set up SPI as master */
-    SPI2CON = 0;
-    SPI2BRG = 4;
-    /* SPI2STAT bit SPIROV = 0; */
-    SPI2STATCLR = 0x40;
-    /* SPI2CON bit CKP = 1; */
-    SPI2CONSET = 0x40;
-    /* SPI2CON bit MSTEN = 1; */
-    SPI2CONSET = 0x20;
-    /* SPI2CON bit ON = 1; */
-    SPI2CONSET = 0x8000;
+    hal_init(); // Set up the clock, the pins and SPI
 
     init(); // Do any lab-specific initialization
 
@@ -0,0 +1,170 @@
+/**
+ * @file    record.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * Records the game being played so it can be played again. A game only
+ * depends on its seed, the tick it was started on and the (debounced)
+ * buttons on every tick after that, see logic_frame(). So that is all a
+ * recording holds, with the buttons as runs of ticks where they didn't
+ * change. The runs are kept in a ring buffer in RAM, if a game is too
+ * long for it the oldest runs are overwritten and the recording can't be
+ * replayed any more, only looked at.
+ *
+ * record_save() turns it into this format, every number little endian:
+ *
+ *     0   4  "TRC1"
+ *     4   1  Flags, bit 0 set if runs were lost
+ *     5   1  0
+ *     6   2  The number of runs n
+ *     8   8  The seed
+ *     16  4  The tick of the first run, the start press
+ *     20  4  The ticks the runs cover, to the game over
+ *     24  2n The runs, the buttons (BTN1 in bit 0) in bit 12-15 and the
+ *            ticks minus one in bit 0-11
+ *
+ * The buttons of the first run are only the start button, the buttons
+ * that were already held then never got to the game. On the host,
+ * ./outfile-host -w file saves the first game it plays and -r file plays
+ * one again.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "declaration.h"    /* Declarations of project specific functions */
+
+// The most ticks a run can cover
+#define RUN_TICKS 4096
+
+static uint16_t runs[RECORD_RUNS];
+static unsigned short head;         // Where the next run goes
+static unsigned short count;        // Runs in the buffer
+static bool lost;                   // Runs have been overwritten
+
+static uint64_t seed;
+static uint32_t start;              // The tick of the oldest run
+static uint32_t since;              // The tick the buttons last changed
+static unsigned char buttons;       // The buttons since then
+static bool recording;
+static bool done;
+
+/**
+ * Adds a run, over the oldest one if the buffer is full.
+ */
+static void run_push(unsigned char held, uint32_t ticks) {
+    if (count == RECORD_RUNS) {
+        start += (runs[head] & 0x0FFF) + 1;
+        lost = true;
+    } else
+        count++;
+
+    runs[head] = held << 12 | (ticks - 1);
+    head = (head + 1) & (RECORD_RUNS - 1);
+}
+
+/**
+ * Ends the current run at a tick, in as many runs as it takes.
+ */
+static void run_end(uint32_t time) {
+    uint32_t ticks = time - since;
+
+    for(; ticks > RUN_TICKS; ticks -= RUN_TICKS)
+        run_push(buttons, RUN_TICKS);
+    if (ticks)
+        run_push(buttons, ticks);
+    since = time;
+}
+
+/**
+ * Starts recording a game, the last recording is thrown away.
+ *
+ * @param [in] game_seed The seed the game was started with
+ * @param [in] time The tick of the press that started it
+ * @param [in] button The button that started it
+ */
+void record_start(uint64_t game_seed, uint32_t time, unsigned char button) {
+    head = count = 0;
+    lost = false;
+    seed = game_seed;
+    start = since = time;
+    buttons = button;
+    recording = true;
+    done = false;
+}
+
+/**
+ * Records a press or release.
+ */
+void record_event(const Input_Event *event) {
+    if (!recording)
+        return;
+
+    if (event->time != since)
+        run_end(event->time);
+    if (event->pressed)
+        buttons |= event->button;
+    else
+        buttons &= ~event->button;
+}
+
+/**
+ * Ends the recording at the game over.
+ *
+ * @param [in] time The tick of the logic frame the game ended in
+ */
+void record_stop(uint32_t time) {
+    if (!recording)
+        return;
+
+    run_end(time);
+    recording = false;
+    done = true;
+}
+
+/**
+ * Is there a whole game recorded?
+ */
+bool record_done(void) {
+    return done;
+}
+
+/**
+ * Writes the last whole game recorded in the format above.
+ *
+ * @param [out] out Where it's written
+ * @param [in] size The room there is
+ * @return The bytes written, 0 if there's no game or no room for it
+ */
+unsigned int record_save(uint8_t *out, unsigned int size) {
+    unsigned int bytes = RECORD_HEADER + 2 * count;
+    uint32_t length = since - start;
+    unsigned short i, run;
+
+    if (!done || size < bytes)
+        return 0;
+
+    out[0] = 'T';
+    out[1] = 'R';
+    out[2] = 'C';
+    out[3] = '1';
+    out[4] = lost;
+    out[5] = 0;
+    out[6] = count;
+    out[7] = count >> 8;
+    for(i = 0; i < 8; i++)
+        out[8 + i] = seed >> 8 * i;
+    for(i = 0; i < 4; i++) {
+        out[16 + i] = start >> 8 * i;
+        out[20 + i] = length >> 8 * i;
+    }
+
+    // From the oldest run
+    run = (head - count) & (RECORD_RUNS - 1);
+    for(i = 0; i < count; i++) {
+        out[RECORD_HEADER + 2 * i] = runs[run];
+        out[RECORD_HEADER + 2 * i + 1] = runs[run] >> 8;
+        run = (run + 1) & (RECORD_RUNS - 1);
+    }
+    return bytes;
+}
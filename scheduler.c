@@ -0,0 +1,125 @@
+/**
+ * @file    scheduler.c
+ * @author  Joel Wachsler (wachsler@kth.se)
+ * @author  Marcus Werlinder (werli@kth.se)
+ * @date    2016
+ * @copyright For copyright and licensing, see file COPYING
+ *
+ * A small scheduler driven by the timer interrupt. Every task has a
+ * period in scheduler ticks. When a task is due it's either run right
+ * away in the interrupt or counted as due and run later from the
+ * main loop, which sleeps while nothing is due. A main loop task that
+ * falls behind is run once for every period it missed, so fixed time
+ * steps like the game logic catch up instead of slowing down.
+ */
+
+#include <stdint.h>         /* Declarations of uint_32 and the like */
+#include "declaration.h"    /* Declarations of project specific functions */
+
+// The most tasks that can be added
+#define SCHEDULER_TASKS 4
+
+typedef struct {
+    Task task;
+    unsigned short period;      // Ticks between each run
+    unsigned short countdown;   // Ticks until the next run
+    bool in_isr;                // Run from the interrupt instead of the main loop
+    volatile unsigned char due; // Times it has been due, counted by the interrupt
+    unsigned char done;         // Times it has been run by the main loop
+} Scheduled_Task;
+
+static Scheduled_Task tasks[SCHEDULER_TASKS];
+static unsigned char task_count = 0;
+// Ticks since start, used as a time base
+static volatile uint32_t ticks = 0;
+// Set by the interrupt when there's something for the main loop to run
+static volatile bool pending = false;
+
+/**
+ * Adds a task to the scheduler.
+ *
+ * @param [in] task The function to run
+ * @param [in] period How many ticks between each run
+ * @param [in] in_isr true if the task is short enough to run in the interrupt
+ * @return false if there's no room for the task
+ */
+bool scheduler_add(Task task, unsigned short period, bool in_isr) {
+    if (task_count == SCHEDULER_TASKS || period == 0)
+        return false;
+
+    tasks[task_count].task = task;
+    tasks[task_count].period = period;
+    tasks[task_count].countdown = period;
+    tasks[task_count].in_isr = in_isr;
+    tasks[task_count].due = 0;
+    tasks[task_count].done = 0;
+    task_count++;
+    return true;
+}
+
+/**
+ * Called from the timer interrupt once every tick. Runs the interrupt
+ * tasks that are due and marks the rest for the main loop.
+ */
+void scheduler_tick(void) {
+    unsigned char i;
+
+    ticks++;
+    for(i = 0; i < task_count; i++) {
+        if (--tasks[i].countdown)
+            continue;
+
+        tasks[i].countdown = tasks[i].period;
+        if (tasks[i].in_isr)
+            tasks[i].task();
+        else {
+            // Don't let it wrap around to done, that would lose 256 runs
+            if ((unsigned char) (tasks[i].due + 1) != tasks[i].done)
+                tasks[i].due++;
+            pending = true;
+        }
+    }
+}
+
+/**
+ * Runs the tasks the interrupt has marked as due, in the order they
+ * were added. The due and done counts are only written on one side
+ * each, so there's no need to turn off interrupts.
+ *
+ * @return false if there was nothing to run
+ */
+bool scheduler_run(void) {
+    unsigned char i;
+
+    if (!pending)
+        return false;
+
+    pending = false;
+    for(i = 0; i < task_count; i++)
+        while(tasks[i].done != tasks[i].due) {
+            tasks[i].done++;
+            tasks[i].task();
+        }
+    return true;
+}
+
+/**
+ * Sleeps until the next interrupt unless there's already something to
+ * run. Interrupts are turned off while checking so one that comes in
+ * between the check and the sleep isn't missed, it still wakes the
+ * core and is taken once they are turned on again.
+ */
+void scheduler_idle(void) {
+    disable_interrupt();
+    if (!pending)
+        sleep_until_interrupt();
+    else
+        enable_interrupt();
+}
+
+/**
+ * Ticks since start.
+ */
+uint32_t scheduler_ticks(void) {
+    return ticks;
+}
@@ -11,52 +11,59 @@
 */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"    /* Declarations of project specific functions */
 #include <stdbool.h>        /* To be able to use boolean */
 
 static unsigned char btns;
+static uint32_t btnsTime;   // The tick btns was pressed on
 static unsigned char menuPointer;
-static unsigned int score;
-static unsigned char level;
-static unsigned int totalRows;
-static unsigned int scores[8] = {0};
+static uint32_t scores[8] = {0};  // In BCD as well
+static Score_Cache scoreCache;
 
-static uint64_t gametick = 0;
 static uint64_t seed = 0;
+// Set to start the next game from nextSeed instead, to replay it
+static bool seedSet = false;
+static uint64_t nextSeed;
 
-static Shape shape;
 static Shape menuSelect;
-static Shape shape2;
+// The game being played, or the last one
+static Game_State state;
 
-static bool rotateSpam = false;
+// Set when something on the screen has changed since it was last drawn
+static bool dirty = true;
 
-// Variable for preventing multiple button values
-static bool btn4Check = false;
+// The tick of the logic frame being run. The frames are LOGIC_PERIOD
+// ticks apart however late they are run, so the game doesn't depend on
+// when the main loop got to them.
+static uint32_t logicTick;
+// The buttons held at logicTick, after debouncing
+static unsigned char held;
 
 typedef enum {
     MAIN_MENU,
     GAME,
-    HISCORE
+    HISCORE,
+    GAME_OVER       // The animation after the game
 } Game_Screen;
 
 // The current game screen
 Game_Screen current_game_screen;
 
-/**
- * Get button values.
- */
-unsigned char getbtns(void) {
-    return PORTD >> 4 & 0b1110 | PORTF >> 1 & 0x01;
-}
+static void logic_frame(void);
+static void render_frame(void);
+static void animation_frame(void);
+
+// The background of each game screen
+static const Layer screen_layers[] = { LAYER_MENU, LAYER_GAME, LAYER_HISCORE, LAYER_BLANK };
 
 /**
  * Save score.
  *
  * @param [in] score The score to save.
  */
-void save_score(unsigned int score) {
-    unsigned int temp = score;
+void save_score(uint32_t score) {
+    // BCD numbers are in the same order as the numbers they hold
+    uint32_t temp = score;
     unsigned char i;
     for(i = 0; i < 8; i++)
         if (scores[i] < score) {
@@ -71,45 +78,22 @@ void save_score(unsigned int score) {
 */
 static void timer_init(void) {
     // TIMER
-    T2CON = 0x70;                   // Stop timer and set prescale to 1:256
-    PR2 = (80000000 / 256) / 10;    // Set period to flag 10 times a second
-    T2CONSET = 0x8000;              // Start the timer (the bit to start the timer's located at bit 15)
-}
-
-/**
-* Hardware button init
-*/
-static void btn_init(void) {
-    // Init port D
-    // Set bits 11 through 5 to 1 (input)
-    TRISDSET = 0b1111111 << 5;
+    hal_timer_init(SCHEDULER_HZ);           // One interrupt every scheduler tick
+    hal_irq_enable(HAL_IRQ_TIMER, 4);       // Timer 2 priority 4
 }
 
 /**
  * Prepare the game before start.
  */
 static void game_init(void) {
+    uint64_t gameSeed = seedSet ? nextSeed : seed;
+
+    seedSet = false;
     current_game_screen = GAME;
-    level = 0;
-    score = 0;
-    totalRows = 0;
-
-    // Set seed
-    rng.state = 0U;
-    rng.inc = (seed << 1u) | 1u;
-    pcg32_random_r(&rng);
-    rng.state += seed;
-    pcg32_random_r(&rng);
-
-    draw_borders();
-    setGrid();//To set the borders in the grid to true
-
-    randomize_piece(&shape);
-    create_shape(&shape);
-    randomize_piece(&shape2);
-    adapt_piece(&shape2);
-
-    render();
+    game_start(&state, gameSeed, btnsTime);
+    record_start(gameSeed, btnsTime, btns);
+
+    dirty = true;
 }
 
 /**
@@ -124,13 +108,13 @@ static void main_menu_init(void) {
     menuSelect.piece[0].x = 1;
     menuSelect.piece[0].y = 29;
 
-    render();
+    dirty = true;
 }
 
 static void hiscore_init(void) {
     current_game_screen = HISCORE;
 
-    render();
+    dirty = true;
 }
 
 /**
@@ -142,6 +126,14 @@ void init(void) {
     display_update();
 
     main_menu_init();   // Start the main menu
+
+    // The logic is added first so a frame is drawn after the logic it shows
+    scheduler_add(logic_frame, LOGIC_PERIOD, false);
+    scheduler_add(render_frame, RENDER_PERIOD, false);
+    scheduler_add(animation_frame, ANIMATION_PERIOD, false);
+    input_init();
+    render_use_interrupt();
+    enable_interrupt();
 }
 
 static void main_menu(void) {
@@ -152,7 +144,7 @@ static void main_menu(void) {
             else
                 hiscore_init();
 
-            break;
+            return;
         case 2:
             menuSelect.piece[0].y = 25;
             menuPointer = 1;
@@ -162,160 +154,202 @@ static void main_menu(void) {
              menuPointer = 0;
              break;
     }
+}
 
+static void main_menu_draw(void) {
     draw_square(&menuSelect.piece[0]);
-    draw_menu();
 }
 
 /**
  * This function's called at game over.
  */
 void game_over(void) {
-    draw_gameScreen();
-    draw_shape(&shape2);
-    draw_shape(&shape);
-    draw_grid_pieces();
-    draw_borders();
-    draw_score(score, 22);
+    frame_begin(LAYER_GAME);
+    draw_shape(&state.next);
+    draw_shape(&state.shape);
+    draw_grid_pieces(&state);
+    draw_score_cached(&scoreCache, state.score, 22);
 
-    save_score(score);
+    save_score(state.score);
+    record_stop(logicTick);
 
+    // The game keeps running while the animation plays, it's taken one
+    // step further by the scheduler until it's time for the main menu
     animation_start();
-    main_menu_init();
+    current_game_screen = GAME_OVER;
+    dirty = true;
+}
+
+static void game_draw(void) {
+    Shape ghost = state.shape;
+    int i, distance = drop_distance(&state, &state.shape);
+
+    // Where the shape would land
+    if (distance) {
+        for(i = 0; i < 4; i++)
+            ghost.piece[i].y -= distance;
+        draw_ghost(&ghost);
+    }
+
+    draw_shape(&state.next);
+    draw_shape(&state.shape);
+    draw_grid_pieces(&state);
+    draw_score_cached(&scoreCache, state.score, 22);
 }
 
 /**
- * This is the actual game.
+ * Goes back to the main menu on any button.
  */
-static void game(void) {
-    switch(btns) {
-        case 1:
-            if(belowCheck(&shape)){
-                gravity(&shape);
-                score += 10;
-            } else {
-                shape.piece_type = shape2.piece_type;
-                create_shape(&shape);
-                if (!belowCheck(&shape)) {
-                    game_over();
-                    return;
-                }
-                randomize_piece(&shape2);
-                adapt_piece(&shape2);
-            }
-            break;
-        case 2:
-            if(sideCheck(&shape, 1)) //Now we want to check if we can actually go to the sides
-                moveSideways(&shape, 1);
-            break;
-        case 4:
-            if(sideCheck(&shape, -1))
-                moveSideways(&shape, -1);
+static void hiscore(void) {
+    if (btns)
+        main_menu_init();
+}
+
+/**
+ * Renders the highscore.
+ */
+static void hiscore_draw(void) {
+    // The places and "HISCORE" text are in the background
+    unsigned char i = 0;
+    for(i = 0; i < 8; i++)
+        draw_score(scores[i], 7*2*(i + 1) + 4);
+}
+
+/**
+ * Lets the current screen act on btns.
+ */
+static void screen_input(void) {
+    dirty = true;
+
+    switch(current_game_screen) {
+        case MAIN_MENU:
+            main_menu();
             break;
-        case 8:
-            if(rotateCheck(&shape)) {
-                // Prevent rotation spamming
-                if (!rotateSpam) {
-                    rotateSpam = true;
-                    rotate_shape(&shape);
-                }
-            }
+        case HISCORE:
+            hiscore();
             break;
         default:
-            rotateSpam = false;
+            // The game takes its presses in logic_frame and there's
+            // nothing to do until the animation is over
+            break;
+    }
+}
+
+/**
+ * Draws the current screen and starts sending it, the frame is sent
+ * while we wait for the next interrupt.
+ */
+static void screen_draw(void) {
+    frame_begin(screen_layers[current_game_screen]);
 
+    switch(current_game_screen) {
+        case MAIN_MENU:
+            main_menu_draw();
+            break;
+        case GAME:
+            game_draw();
+            break;
+        case HISCORE:
+            hiscore_draw();
+            break;
+        case GAME_OVER:
+            draw_animation();
+            break;
     }
 
-    // Tick once a second
-    if (gametick++ % (10-level) == 0) {
-        if(belowCheck(&shape))
-            gravity(&shape);
-        else {
-            shape.piece_type = shape2.piece_type;
-            create_shape(&shape);
-            if (!belowCheck(&shape)) {
-                game_over();
-
-                return;
-            }
-            randomize_piece(&shape2);
-            adapt_piece(&shape2);
-        }
+    frame_present();
+}
+
+/**
+* Runs the logic of the current screen, LOGIC_HZ times a second. The
+* menus act on every press right away, in the game the presses since the
+* last frame are handed to game_step() together with the held buttons.
+* Only the buttons from before logicTick are taken, so a game is the same
+* every time it gets the same seed and buttons (see record.c).
+*/
+static void logic_frame(void) {
+    Input_Event event;
+    Game_Input input = {0};
+    unsigned char i;
 
-        // Original tetris scores
-        unsigned short rows = fullRow();
-        totalRows += rows;
-        switch(rows) {
-            case 1:
-                score += 40 * (level + 1);
-                break;
-            case 2:
-                score += 100 * (level + 1);
-                break;
-            case 3:
-                score += 300 * (level + 1);
-                break;
-            case 4:
-                score += 1200 * (level + 1);
-                break;
+    logicTick += LOGIC_PERIOD;
+    while(input_pop(&event, logicTick)) {
+        if (event.pressed)
+            held |= event.button;
+        else
+            held &= ~event.button;
+
+        if (current_game_screen != GAME) {
+            if (!event.pressed)
+                continue;
+            btns = event.button;
+            btnsTime = event.time;
+            screen_input();
+            continue;
         }
 
-        // Original level calulcaton
-        level = totalRows > 99 ? 9: totalRows / 10;
+        record_event(&event);
+        if (!event.pressed)
+            continue;
+        for(i = 0; event.button >> i > 1; i++);
+        input.pressed |= event.button;
+        input.pressed_at[i] = event.time;
     }
 
-    draw_gameScreen();
-    draw_shape(&shape2);
-    draw_shape(&shape);
-    draw_grid_pieces();
-    draw_borders();
-    draw_score(score, 22);
+    if (current_game_screen != GAME)
+        return;
+
+    input.time = logicTick;
+    input.held = held;
+    if (game_step(&state, &input))
+        dirty = true;
+    if (state.over)
+        game_over();
 }
 
 /**
- * Renders the highscore.
- */
-static void hiscore(void) {
-    if (btns)
-        main_menu_init();
+* Draws the screen if it has changed and the last frame has been sent
+*/
+static void render_frame(void) {
+    if (!dirty || render_busy())
+        return;
 
-    unsigned char i = 0;
-    for(i = 0; i < 8; i++) {
-        draw_score(scores[i], 7*2*(i + 1) + 4);
-        draw_number(i + 1, 7, 7*2*(i + 1) - 7 + 4);
-        draw_punctuation(7*2*(i + 1) - 7 + 1 + 4);
-    }
+    dirty = false;
+    screen_draw();
+}
 
-    // Draw "HISCORE" text
-    draw_hiscore();
+/**
+* Takes the game over animation one step further and goes to the main
+* menu when it's over
+*/
+static void animation_frame(void) {
+    if (current_game_screen != GAME_OVER)
+        return;
+
+    if (animation_step())
+        dirty = true;
+    else
+        main_menu_init();
+}
+
+/**
+* Makes the next game start from a seed of our choosing instead of the
+* time it took to press start, to play a recorded game again.
+*
+* @param [in] value The seed
+*/
+void game_seed(uint64_t value) {
+    nextSeed = value;
+    seedSet = true;
 }
 
 /**
 * This function is called over and over again
 */
 void update(void) {
-    // Check btn3, btn2 and btn1 as many times as possible
-    btns = getbtns();
     seed++;
 
-    if (IFS(0) & 0x100) {
-        IFS(0) = 0; // Reset timer flag
-        /*unsigned int item = (98765 % pow(10, 2)) / pow(10, 1);*/
-        /*display_debug(&item);*/
-
-        switch(current_game_screen) {
-            case MAIN_MENU:
-                main_menu();
-                break;
-            case GAME:
-                game();
-                break;
-            case HISCORE:
-                hiscore();
-                break;
-        }
-
-        // Update the screen 10 times a second
-        render();
-   }
+    // Sleep until the next interrupt if there was nothing to do
+    if (!scheduler_run())
+        scheduler_idle();
 }
@@ -9,7 +9,6 @@
  */
 
 #include <stdint.h>         /* Declarations of uint_32 and the like */
-#include <pic32mx.h>        /* Declarations of system-specific addresses etc */
 #include "declaration.h"    /* Declarations of project specific functions */
 
 // Define the start origin on the game field
@@ -18,34 +17,110 @@
 
 // Random pieces
 static const Piece_Type pieces[] = { I, L, J, O, T, Z, S };
-// Random seed
-pcg32_random_t rng;
 
-// Create an 33 * 11 boolean array that will represent the grid for tetris.
-bool grid[(32+1)*(10+2)] = {false};
+// The squares of every piece_type in each of the 4 orientations, as
+// offsets from the first square which is the origin of the piece.
+// Each orientation is the one before it rotated a quarter turn
+// (x' = xc + yc - y, y' = yc - xc + x).
+static const signed char rotations[7][4][4][2] = {
+    // Long piece (I)
+    {
+        { { 0,  0}, {-1,  0}, {-2,  0}, { 1,  0} },
+        { { 0,  0}, { 0, -1}, { 0, -2}, { 0,  1} },
+        { { 0,  0}, { 1,  0}, { 2,  0}, {-1,  0} },
+        { { 0,  0}, { 0,  1}, { 0,  2}, { 0, -1} },
+    },
+    // L
+    {
+        { { 0,  0}, { 1,  0}, {-1,  0}, {-1, -1} },
+        { { 0,  0}, { 0,  1}, { 0, -1}, { 1, -1} },
+        { { 0,  0}, {-1,  0}, { 1,  0}, { 1,  1} },
+        { { 0,  0}, { 0, -1}, { 0,  1}, {-1,  1} },
+    },
+    // J
+    {
+        { { 0,  0}, { 1,  0}, {-1,  0}, { 1, -1} },
+        { { 0,  0}, { 0,  1}, { 0, -1}, { 1,  1} },
+        { { 0,  0}, {-1,  0}, { 1,  0}, {-1,  1} },
+        { { 0,  0}, { 0, -1}, { 0,  1}, {-1, -1} },
+    },
+    // Big square (O), looks the same in every orientation
+    {
+        { { 0,  0}, { 1,  0}, { 0,  1}, { 1,  1} },
+        { { 0,  0}, { 1,  0}, { 0,  1}, { 1,  1} },
+        { { 0,  0}, { 1,  0}, { 0,  1}, { 1,  1} },
+        { { 0,  0}, { 1,  0}, { 0,  1}, { 1,  1} },
+    },
+    // Triangle (T)
+    {
+        { { 0,  0}, { 0, -1}, {-1,  0}, { 1,  0} },
+        { { 0,  0}, { 1,  0}, { 0, -1}, { 0,  1} },
+        { { 0,  0}, { 0,  1}, { 1,  0}, {-1,  0} },
+        { { 0,  0}, {-1,  0}, { 0,  1}, { 0, -1} },
+    },
+    // Zigzag left (Z)
+    {
+        { { 0,  0}, { 0,  1}, {-1,  1}, { 1,  0} },
+        { { 0,  0}, {-1,  0}, {-1, -1}, { 0,  1} },
+        { { 0,  0}, { 0, -1}, { 1, -1}, {-1,  0} },
+        { { 0,  0}, { 1,  0}, { 1,  1}, { 0, -1} },
+    },
+    // Zigzag right (S)
+    {
+        { { 0,  0}, { 0,  1}, { 1,  1}, {-1,  0} },
+        { { 0,  0}, {-1,  0}, {-1,  1}, { 0, -1} },
+        { { 0,  0}, { 0, -1}, {-1, -1}, { 1,  0} },
+        { { 0,  0}, { 1,  0}, { 1, -1}, { 0,  1} },
+    },
+};
+
+// The offsets a rotated piece is moved by, in order, until it fits.
+// Only the long piece can need two steps to get away from a wall.
+static const signed char kicks[5][2] = { {0, 0}, {-1, 0}, {1, 0}, {-2, 0}, {2, 0} };
+#define KICK_COUNT(type) ((type) == I ? 5 : 3)
+
+// Bit for column x in a grid row. Column -1 and 10 are the walls.
+#define GRID_CELL(x) (1 << ((x) + 1))
+// The wall bits of a row
+#define GRID_WALLS (GRID_CELL(-1) | GRID_CELL(10))
+// A row where every column (walls included) is taken
+#define GRID_FULL 0x0FFF
+
+// The grid of a game is a 33 row bitboard, state->grid.
+// Each row is a mask where bit 1 through 10 are the squares on the row
+// and bit 0 and 11 are the walls. Row 0 is the floor so the square
+// at (x, y) lives in bit x + 1 of grid[y + 1].
+//
+// Next to it is state->skyline, the height of every column, one above
+// its highest taken square or 0 if it's empty. Kept up to date when
+// shapes are locked and rows removed so it never has to be found by
+// going through the grid.
 
 /**
 * Create the borders for the grid and set everything else to false
+* @param [out] state The game whose grid is set up
 */
-void setGrid(void) {
-    unsigned char x, y;
-    for(y = 0; y < 32; y++)
-        for(x = 0; x < 12; x++) {
-            if(x == 0 || x == 11 || y == 0)//To declare all the borders as true
-                grid[x + y * 12] = true;
-            else
-                grid[x + y * 12] = false;//Everyting else will be false at start
-        }
+void setGrid(Game_State *state) {
+    unsigned char y;
+    for(y = 0; y < 32 + 1; y++)
+        if(y == 0)//The floor is a border as well
+            state->grid[y] = GRID_FULL;
+        else
+            state->grid[y] = GRID_WALLS;//Everyting but the walls will be false at start
+
+    for(y = 0; y < 10; y++)
+        state->skyline[y] = 0;
 }
 
 /**
  * Sets the piece_type to a random one.
  *
+ * @param [in,out] state The game the piece is drawn for
  * @param [out] shape Pointer to the shape where the random piece will be put
  */
-void randomize_piece(Shape *shape) {
+void randomize_piece(Game_State *state, Shape *shape) {
     // Randomize the piece
-    shape->piece_type = pieces[pcg32_random_r(&rng) % 7];
+    shape->piece_type = pieces[pcg32_random_r(&state->rng) % 7];
 }
 
 /**
@@ -64,107 +139,13 @@ void randomize_piece(Shape *shape) {
  * @param [out] shape Pointer to the resulting struct with the id already defined
  */
 void create_shape(Shape *shape) {
-    // The pieces are always created at the same origin coordinate (4, 28)
-    // 5 coords from the top.
-    switch(shape->piece_type) {
-        case I:
-            // Bottom
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Left
-            shape->piece[1].x = ORIGIN_X-1;
-            shape->piece[1].y = ORIGIN_Y;
-            // Two left
-            shape->piece[2].x = ORIGIN_X-2;
-            shape->piece[2].y = ORIGIN_Y;
-            // Right
-            shape->piece[3].x = ORIGIN_X+1;
-            shape->piece[3].y = ORIGIN_Y;
-            break;
-        case L:
-            // Center
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Right
-            shape->piece[1].x = ORIGIN_X+1;
-            shape->piece[1].y = ORIGIN_Y;
-            // Left
-            shape->piece[2].x = ORIGIN_X-1;
-            shape->piece[2].y = ORIGIN_Y;
-            // Bottom left
-            shape->piece[3].x = ORIGIN_X-1;
-            shape->piece[3].y = ORIGIN_Y-1;
-            break;
-        case J:
-            // Center
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Right
-            shape->piece[1].x = ORIGIN_X+1;
-            shape->piece[1].y = ORIGIN_Y;
-            // Left
-            shape->piece[2].x = ORIGIN_X-1;
-            shape->piece[2].y = ORIGIN_Y;
-            // Bottom right
-            shape->piece[3].x = ORIGIN_X+1;
-            shape->piece[3].y = ORIGIN_Y-1;
-            break;
-        case O:
-            // Bottom left
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Bottom right
-            shape->piece[1].x = ORIGIN_X + 1;
-            shape->piece[1].y = ORIGIN_Y;
-            // Top left
-            shape->piece[2].x = ORIGIN_X;
-            shape->piece[2].y = ORIGIN_Y + 1;
-            // Top right
-            shape->piece[3].x = ORIGIN_X + 1;
-            shape->piece[3].y = ORIGIN_Y + 1;
-            break;
-        case T:
-            // Top center
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Bottom center
-            shape->piece[1].x = ORIGIN_X;
-            shape->piece[1].y = ORIGIN_Y-1;
-            // Top left
-            shape->piece[2].x = ORIGIN_X-1;
-            shape->piece[2].y = ORIGIN_Y;
-            // Top right
-            shape->piece[3].x = ORIGIN_X+1;
-            shape->piece[3].y = ORIGIN_Y;
-            break;
-        case Z:
-            // Bottom center
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Top center
-            shape->piece[1].x = ORIGIN_X;
-            shape->piece[1].y = ORIGIN_Y+1;
-            // Top left
-            shape->piece[2].x = ORIGIN_X-1;
-            shape->piece[2].y = ORIGIN_Y+1;
-            // Bottom right
-            shape->piece[3].x = ORIGIN_X+1;
-            shape->piece[3].y = ORIGIN_Y;
-            break;
-        case S:
-            // Bottom center
-            shape->piece[0].x = ORIGIN_X;
-            shape->piece[0].y = ORIGIN_Y;
-            // Top center
-            shape->piece[1].x = ORIGIN_X;
-            shape->piece[1].y = ORIGIN_Y+1;
-            // Top right
-            shape->piece[2].x = ORIGIN_X+1;
-            shape->piece[2].y = ORIGIN_Y+1;
-            // Bottom left
-            shape->piece[3].x = ORIGIN_X-1;
-            shape->piece[3].y = ORIGIN_Y;
-            break;
+    // The pieces are always created at the same origin coordinate (4, 26)
+    // in their first orientation.
+    unsigned char i;
+    shape->rotation = 0;
+    for(i = 0; i < 4; i++) {
+        shape->piece[i].x = ORIGIN_X + rotations[shape->piece_type][0][i][0];
+        shape->piece[i].y = ORIGIN_Y + rotations[shape->piece_type][0][i][1];
     }
 }
 
@@ -278,31 +259,35 @@ void adapt_piece(Shape *shape){
 }
 
 /**
- * This function will change the shape of the item passed to it
+ * This function will change the shape of the item passed to it to its
+ * next orientation. If the rotated shape hits something it's moved
+ * sideways by the kicks until it fits.
  *
+ * @param [in] state The game the shape is in
  * @param [out] shape Pointer to the shape which will be rotated
+ * @return false if the shape couldn't be rotated
  */
-void rotate_shape(Shape *shape) {
-    // The square cannot be rotated
-    if (shape->piece_type == O)
-        return;
-
-    unsigned char i, x, y, xc, yc;
-    xc = shape->piece[0].x;
-    yc = shape->piece[0].y;
-    // Go through each square.
-    // The first square is always the origin of the piece
-    // so we don't have to do anything about that one.
-    for(i = 1; i < 4; i++){
-        // Applying the tetris formula for rotation
-        // x' = xc + yc - y
-        // y' = yc - xc + x
-        // where (xc, yc) are the origin coordinates
-        x = shape->piece[i].x;
-        y = shape->piece[i].y;
-        shape->piece[i].x = xc + yc - y;
-        shape->piece[i].y = yc - xc + x;
+bool rotate_shape(const Game_State *state, Shape *shape) {
+    unsigned char i, k, rotation;
+    int x, y;
+
+    for(k = 0; k < KICK_COUNT(shape->piece_type); k++) {
+        if(collides(state, shape, kicks[k][0], kicks[k][1], 1))
+            continue;
+
+        // The first square is always the origin of the piece
+        // and the rest are looked up from there.
+        x = shape->piece[0].x + kicks[k][0];
+        y = shape->piece[0].y + kicks[k][1];
+        rotation = (shape->rotation + 1) & 3;
+        for(i = 0; i < 4; i++) {
+            shape->piece[i].x = x + rotations[shape->piece_type][rotation][i][0];
+            shape->piece[i].y = y + rotations[shape->piece_type][rotation][i][1];
+        }
+        shape->rotation = rotation;
+        return true;
     }
+    return false;
 }
 
 /**
@@ -332,155 +317,127 @@ void moveSideways(Shape *shape, int way) {
     }
 }
 
-Shape gridShape; //To be able to write out grid
-Shape rotateCopy; //Is going to be a rotate dummy
-
 /**
-* This function will check if something is below
-* the Tetris piece. It also sends back 1 or 0 if we
-* should interrupt gravity and start a new piece
+* This function will check if the shape would hit something if it was
+* moved and rotated. Neither the shape nor the grid is changed so it can
+* be used to try out as many positions as needed.
+* @param [in] state The game whose grid is checked
 * @param [in] shape has 4 squares that all have x and y that we want to check
+* @param [in] dx How far the shape is moved along x
+* @param [in] dy How far the shape is moved along y
+* @param [in] rot How many times the shape is rotated before it is moved
+* @return true if any square is outside the field or on a taken square
 */
-bool belowCheck(Shape *shape){
-    int i;//Loop array to set all squares as true if something below
-    int j;//-||-
+bool collides(const Game_State *state, const Shape *shape, int dx, int dy, unsigned char rot){
+    const signed char (*offsets)[2] = rotations[shape->piece_type][(shape->rotation + rot) & 3];
+    int i;
+    int x;
+    int y;
 
-    int x;//The y and x cordinates that we will translate into the right in
-    int y;//grid
     for(i = 0; i < 4; i++){
-        x = shape->piece[i].x;//Test every square in the shape if it collides
-        y = shape->piece[i].y;
-        if(grid[(x + 1) + y * 12]){//Check if the arraybox below is true or not
-            for(j = 0; j < 4; j++){
-                x = shape->piece[j].x;//Set every square as true in grid
-                y = shape->piece[j].y;
-                grid[(x + 1) + (y * 12) + 12] = true;// This will set all the shapes boxes
-            }
-            return false;                          // as true
-        }
+        x = shape->piece[0].x + offsets[i][0] + dx;
+        y = shape->piece[0].y + offsets[i][1] + dy;
+        if(x < 0 || x > 9 || y < 0 || y > 31)
+            return true;
+        if(state->grid[y + 1] & GRID_CELL(x))
+            return true;
     }
-    return true;
+    return false;
 }
 
 /**
-* This function will check if we hit a wall from the right or left
-* @param [in] shape has 4 squares that all have x and y that we want to check
-* @param [in] LorR is an int that tells if we want to go left or right
+* Puts the shape in the grid where it is right now.
+* @param [in,out] state The game whose grid the shape goes into
+* @param [in] shape The shape to lock into the grid
+* @param [out] locked The rows the shape covers
 */
-bool sideCheck(Shape *shape, int LorR){
-    int i;//Loop array to set all squares as true if something below
-
-    int x;//The y and x cordinates that we will translate into the right box in
-    int y;//grid
+void lock_shape(Game_State *state, const Shape *shape, Row_Range *locked){
+    int i;
 
-    for(i = 0; i < 4; i++){
-        x = shape->piece[i].x;//Set every square as true in grid
-        y = shape->piece[i].y;
-        if(grid[(x + 1) + (y * 12) + 12 + LorR])//To check one box to the left
-        return false;
+    locked->bottom = locked->top = shape->piece[0].y;
+    for(i = 0; i < 4; i++){// This will set all the shapes boxes as true
+        state->grid[shape->piece[i].y + 1] |= GRID_CELL(shape->piece[i].x);
+        if(shape->piece[i].y < locked->bottom)
+            locked->bottom = shape->piece[i].y;
+        if(shape->piece[i].y > locked->top)
+            locked->top = shape->piece[i].y;
+        if(shape->piece[i].y >= state->skyline[shape->piece[i].x])
+            state->skyline[shape->piece[i].x] = shape->piece[i].y + 1;
     }
-
-    return true;
 }
 
 /**
-* This function will check if we can actually rotate the piece
-* @param [in] the shape we want to check for rotation
+* How far the shape can fall before it hits something. When every square
+* is above the top of its column it's found from the skyline alone.
+* Otherwise the shape has been moved in under something and it's tried a
+* row at a time.
+* @param [in] state The game the shape is in
+* @param [in] shape The shape to drop
+* @return How many rows it can fall
 */
-bool rotateCheck(Shape *shape){
+int drop_distance(const Game_State *state, const Shape *shape){
     int i;
-    rotateCopy.piece_type = shape->piece_type;
-    create_shape(&rotateCopy);//The dummy is alive MUAHAHAHHAHAH
-    for(i = 0; i < 4; i++){
-        rotateCopy.piece[i].x = shape->piece[i].x;
-        rotateCopy.piece[i].y = shape->piece[i].y;
-    }
-    rotate_shape(&rotateCopy);
-    for(i = 0; i < 4; i++){
-        if(grid[(rotateCopy.piece[i].x + 1) + (rotateCopy.piece[i].y * 12) + 12]
-           || rotateCopy.piece[i].x < 0 || rotateCopy.piece[i].x > 9 ||
-           rotateCopy.piece[i].y < 0){
+    int distance = 32;
 
-            return false;
-        }
-    }
-    return true;
-}
+    for(i = 0; i < 4; i++)
+        if(shape->piece[i].y - state->skyline[shape->piece[i].x] < distance)
+            distance = shape->piece[i].y - state->skyline[shape->piece[i].x];
 
-/**
-*This function will draw all the true in the gridbox
-*/
-void draw_grid_pieces(){
-    int x, y;
-    gridShape.piece_type = 1;
-    create_shape(&gridShape);
-    for(y = 0; y < 32; y++){
-        for(x = 0; x < 10; x++){
-            if(grid[(x + 1) + (y * 12) + 12]){
-                gridShape.piece[0].x = x;
-                gridShape.piece[0].y = y;
-
-                draw_square(&gridShape.piece[0]);//To draw out all the squares
-            }
-        }
-    }
+    if(distance < 0)
+        for(distance = 0; !collides(state, shape, 0, -(distance + 1), 0); distance++);
 
+    return distance;
 }
 
 /**
- *Fixer is just a bad name for the algoritm that checks if there is a full row
- * @param [in] y tells us what y cordinate we are on
- * @param [in] b tells us if it's case 1 (row not at the bottom) or case 2 when it is at the bottom
- * @param [in] antalRow just tells us how many rows we need to remove
- */
-void fixer(int y, int b, int antalRow){
-    int x;
-    int y2;
-        for(y2 = y + b; y2 < (y + b + antalRow); y2++){//Remove the full rows
-            for(x = 0; x < 10; x++)
-                grid[(x + 1) + (y2 * 12) + 12] = false;
-        }
-        for(y2 = y + b + antalRow; y2 < 32; y2++){//Shift everthing down
-            for(x = 0; x < 10; x++){
-                if(grid[(x + 1) + (y2 * 12) + 12]){
-                    grid[(x + 1) + (y2 * 12) + 12] = false;
-                    grid[(x + 1) + (y2 * 12) + 12 - antalRow * 12] = true;
-                }
-            }
-        }
-}
-/**
- * This program will check if we have mutlipel full rows and will delet them
- * And move the above down
+ * This will remove every full row among the rows passed to it and move
+ * the rows above them down. Only the rows a locked shape covered can have
+ * become full so nothing else is looked at, and if none of them are full
+ * the grid isn't touched at all. Otherwise it's done in one pass from the
+ * lowest full row and up where every row that isn't full is copied down
+ * as a whole.
+ *
+ * @param [in,out] state The game whose grid the rows are removed from
+ * @param [in] rows The rows that should be checked
+ * @param [out] cleared The y coords (before the removal) of the rows that
+ *                      were removed, from the bottom and up. Has room for
+ *                      MAX_CLEARED_ROWS rows.
+ * @return The amount of rows that were removed
  */
-int fullRow(){
-    int x;
+int fullRow(Game_State *state, const Row_Range *rows, unsigned char *cleared){
+    int i;
     int y;
-    int fullrow = 0;
     int antalRow = 0;
-    int antalRowB = 0;
 
-    for(y = 31; y > -1; y--){   // Going through all rows to see if we have a full row
-        fullrow = 0;
-        for(x = 0; x < 10; x++){
-            if(grid[(x + 1) + (y * 12) + 12])
-                fullrow++;
-        }
-        if(fullrow == 10){  // If we have a full row we add one to the amount of rows to remove
-            antalRowB++;
+    // Find the full rows, the range is never more than 4 rows
+    for(y = rows->bottom; y <= rows->top && y < 32; y++)
+        if(state->grid[y + 1] == GRID_FULL && antalRow < MAX_CLEARED_ROWS)
+            cleared[antalRow++] = y;
+
+    if(antalRow == 0)
+        return 0;
+
+    antalRow = 0;
+    for(y = cleared[0] + 1; y < 32 + 1; y++){   // Going through the rows from the lowest full one
+        if(y <= rows->top + 1 && state->grid[y] == GRID_FULL)  // Skip the full rows
             antalRow++;
-        }
-        if(fullrow < 10)    // 1 case when we have a row not at the bottom
-            if(antalRow > 0){
-                fixer(y, 1, antalRow);
-                antalRow = 0;
-        }
-        if(y == 0)          // 2 case when the full row is at the bottom
-            if(antalRow > 0){
-                fixer(y, 0, antalRow);
-                antalRow = 0;
-            }
+        else                                  // Move the row down past the removed ones
+            state->grid[y - antalRow] = state->grid[y];
+    }
+
+    // The rows at the top are empty after everything has been moved down
+    for(y = 32 + 1 - antalRow; y < 32 + 1; y++)
+        state->grid[y] = GRID_WALLS;
+
+    // A full row is below the top of every column, so every column drops
+    // by the removed rows. If its top was in one of them the new top is
+    // found further down.
+    for(i = 0; i < 10; i++){
+        y = state->skyline[i] - antalRow;
+        while(y > 0 && !(state->grid[y] & GRID_CELL(i)))
+            y--;
+        state->skyline[i] = y;
     }
 
-    return antalRowB;
+    return antalRow;
 }